@@ -17,6 +17,14 @@
 
 #include "biquad.h"
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define GROUP 2   /* Channels filtered together, one per SSE2 lane */
+#else
+#define GROUP 1
+#endif
+
+#define BLOCK 512 /* Frames taken through all sections at a time */
 
 typedef biquad_t priv_t;
 
@@ -67,11 +75,29 @@ static int start(sox_effect_t * effp)
   p->b0 /= p->a0;
   p->a2 /= p->a0;
   p->a1 /= p->a0;
-
-  p->o2 = p->o1 = p->i2 = p->i1 = 0;
   return SOX_SUCCESS;
 }
 
+static size_t num_groups(sox_effect_t const * effp)
+{
+  return (effp->in_signal.channels + GROUP - 1) / GROUP;
+}
+
+/* (Re)allocates the filter memory etc. for num_sections sections, clearing
+ * that of any new ones */
+static void alloc_sections(sox_effect_t * effp, size_t num_sections)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t n = 4 * effp->in_signal.channels, old = p->num_sections;
+
+  p->sections = lsx_realloc(p->sections, num_sections * sizeof(*p->sections));
+  p->mem = lsx_realloc(p->mem, num_sections * n * sizeof(*p->mem));
+  memset(p->mem + old * n, 0, (num_sections - old) * n * sizeof(*p->mem));
+  p->clips = lsx_realloc(p->clips,
+      num_groups(effp) * num_sections * sizeof(*p->clips));
+  p->num_sections = num_sections;
+}
+
 
 int lsx_biquad_start(sox_effect_t * effp)
 {
@@ -138,21 +164,201 @@ int lsx_biquad_start(sox_effect_t * effp)
       , p->b0, p->b1, p->b2, 1. /* a0 */, p->a1, p->a2);
     return SOX_EOF;
   }
+  p->num_sections = 0;
+  p->sections = NULL, p->mem = NULL, p->clips = NULL;
+  alloc_sections(effp, 1);
+  p->sections->b0 = p->b0, p->sections->b1 = p->b1, p->sections->b2 = p->b2;
+  p->sections->a1 = p->a1, p->sections->a2 = p->a2;
+  p->sections->name = effp->handler.name;
+  p->sections->clips = 0;
   return SOX_SUCCESS;
 }
 
 
+sox_bool lsx_biquad_absorb(sox_effect_t * effp, sox_effect_t const * next,
+    sox_bool float_link)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  priv_t const * q = (priv_t const *)next->priv;
+  size_t old = p->num_sections;
+
+  if (effp->handler.flow != lsx_biquad_flow || effp->obuf ||
+      next->handler.flow != lsx_biquad_flow || next->obuf ||
+      effp->flows != 1 || next->flows != 1 ||
+      (old > 1 && float_link != p->float_link))
+    return sox_false;
+  alloc_sections(effp, old + q->num_sections);
+  memcpy(p->sections + old, q->sections, q->num_sections * sizeof(*q->sections));
+  p->float_link = float_link;
+  effp->out_signal = next->out_signal;
+  return sox_true;
+}
+
+
+/* How a section passes on its output: as is (to be rounded on output from
+ * the effect), or rounded as if passed from one effect to another */
+typedef enum {link_none, link_int, link_float} link_t;
+
+#define LINK(d) (link == link_none? (d) : link == link_int? \
+    (sox_sample_t)SOX_ROUND_CLIP_COUNT(d, clips) : \
+    (float)((d) * (1 / scale)) * scale)
+
+/* Filters n frames of one channel, held in x, through section s with memory
+ * m (i1, i2, o1 & o2, each stride apart); returns the number clipped */
+static sox_uint64_t filter_1(biquad_section_t const * s, double * m,
+    size_t stride, double * x, size_t n, link_t link)
+{
+  double const scale = SOX_SAMPLE_MAX + 1.;
+  double b0 = s->b0, b1 = s->b1, b2 = s->b2, a1 = s->a1, a2 = s->a2;
+  double i1 = m[0], i2 = m[stride], o1 = m[2 * stride], o2 = m[3 * stride];
+  sox_uint64_t clips = 0;
+
+  for (; n--; ++x) {
+    double o0 = *x*b0 + i1*b1 + i2*b2 - o1*a1 - o2*a2;
+    i2 = i1, i1 = *x;
+    o2 = o1, o1 = o0;
+    *x = LINK(o0);
+  }
+  m[0] = i1, m[stride] = i2, m[2 * stride] = o1, m[3 * stride] = o2;
+  return clips;
+}
+
+#ifdef __SSE2__
+/* As filter_1, but for two channels (interleaved in x) at once */
+static sox_uint64_t filter_2(biquad_section_t const * s, double * m,
+    size_t stride, double * x, size_t n, link_t link)
+{
+  double const scale = SOX_SAMPLE_MAX + 1.;
+  __m128d b0 = _mm_set1_pd(s->b0), b1 = _mm_set1_pd(s->b1);
+  __m128d b2 = _mm_set1_pd(s->b2), a1 = _mm_set1_pd(s->a1);
+  __m128d a2 = _mm_set1_pd(s->a2);
+  __m128d i1 = _mm_loadu_pd(m), i2 = _mm_loadu_pd(m + stride);
+  __m128d o1 = _mm_loadu_pd(m + 2 * stride), o2 = _mm_loadu_pd(m + 3 * stride);
+  sox_uint64_t clips = 0;
+
+  for (; n--; x += 2) {   /* Same order of operations as filter_1 */
+    __m128d x0 = _mm_loadu_pd(x);
+    __m128d o0 = _mm_add_pd(_mm_mul_pd(x0, b0), _mm_mul_pd(i1, b1));
+    o0 = _mm_add_pd(o0, _mm_mul_pd(i2, b2));
+    o0 = _mm_sub_pd(o0, _mm_mul_pd(o1, a1));
+    o0 = _mm_sub_pd(o0, _mm_mul_pd(o2, a2));
+    i2 = i1, i1 = x0;
+    o2 = o1, o1 = o0;
+    _mm_storeu_pd(x, o0);
+    if (link != link_none)
+      x[0] = LINK(x[0]), x[1] = LINK(x[1]);
+  }
+  _mm_storeu_pd(m, i1), _mm_storeu_pd(m + stride, i2);
+  _mm_storeu_pd(m + 2 * stride, o1), _mm_storeu_pd(m + 3 * stride, o2);
+  return clips;
+}
+#endif
+
+
+/* Filters channels c...c+w-1 (w <= GROUP) of len frames; each BLOCK of
+ * frames goes through all of the sections before the next is taken.
+ * Between sections, samples are rounded (& clipped) as they would have been
+ * in passing between separate effects. */
+static void filter_group(sox_effect_t * effp, size_t c, size_t w,
+    sox_sample_t const * ibuf, sox_sample_t * obuf, size_t len,
+    sox_uint64_t * clips)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t channels = effp->in_signal.channels;
+  size_t step = effp->planar? 1 : channels;          /* Between frames */
+  size_t cstep = effp->planar? lsx_plane_size(channels) : 1; /* Channels */
+  size_t offset = c * cstep, stride = channels, i, j, k, n;
+  float const * fibuf = (float const *)ibuf + offset;
+  float * fobuf = (float *)obuf + offset;
+  double const scale = SOX_SAMPLE_MAX + 1.;
+  double x[BLOCK * GROUP];
+
+  ibuf += offset, obuf += offset;
+  for (; len; len -= n) {
+    sox_uint64_t clipped = 0;
+
+    n = min(len, BLOCK);
+    for (j = 0; j < w; ++j) {
+      double * y = x + j;
+      size_t o = j * cstep;
+      if (effp->in_float) for (i = 0; i < n; ++i, y += w)
+        *y = fibuf[i * step + o] * scale;
+      else for (i = 0; i < n; ++i, y += w)
+        *y = ibuf[i * step + o];
+    }
+    for (k = 0; k < p->num_sections; ++k) {
+      double * m = p->mem + 4 * k * channels + c;
+      link_t link = k + 1 == p->num_sections? link_none :
+        p->float_link? link_float : link_int;
+#ifdef __SSE2__
+      if (w == 2)
+        clips[k] += filter_2(p->sections + k, m, stride, x, n, link);
+      else
+#endif
+      clips[k] += filter_1(p->sections + k, m, stride, x, n, link);
+    }
+    for (j = 0, --k; j < w; ++j) {
+      double const * y = x + j;
+      size_t o = j * cstep;
+      if (effp->out_float) for (i = 0; i < n; ++i, y += w)
+        fobuf[i * step + o] = (float)(*y * (1 / scale));
+      else for (i = 0; i < n; ++i, y += w)
+        obuf[i * step + o] = SOX_ROUND_CLIP_COUNT(*y, clipped);
+    }
+    clips[k] += clipped;
+    ibuf += n * step, fibuf += n * step;
+    obuf += n * step, fobuf += n * step;
+  }
+}
+
+
 int lsx_biquad_flow(sox_effect_t * effp, const sox_sample_t *ibuf,
     sox_sample_t *obuf, size_t *isamp, size_t *osamp)
 {
   priv_t * p = (priv_t *)effp->priv;
-  size_t len = *isamp = *osamp = min(*isamp, *osamp);
-  while (len--) {
-    double o0 = *ibuf*p->b0 + p->i1*p->b1 + p->i2*p->b2 - p->o1*p->a1 - p->o2*p->a2;
-    p->i2 = p->i1, p->i1 = *ibuf++;
-    p->o2 = p->o1, p->o1 = o0;
-    *obuf++ = SOX_ROUND_CLIP_COUNT(o0, effp->clips);
+  size_t channels = effp->in_signal.channels, k;
+  size_t len = min(*isamp, *osamp) / channels;
+  int g, groups = (int)num_groups(effp);
+
+  *isamp = *osamp = len * channels;
+  memset(p->clips, 0, groups * p->num_sections * sizeof(*p->clips));
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for \
+      if(sox_globals.use_threads && groups > 1 && \
+         *isamp >= sox_globals.threads_min_samples) \
+      schedule(static) default(none) \
+      shared(effp, p, ibuf, obuf, len, channels, groups)
+#endif
+  for (g = 0; g < groups; ++g) {
+    size_t c = (size_t)g * GROUP;
+    filter_group(effp, c, min(GROUP, channels - c), ibuf, obuf, len,
+        p->clips + g * p->num_sections);
+  }
+  for (g = 0; g < groups; ++g) for (k = 0; k < p->num_sections; ++k) {
+    p->sections[k].clips += p->clips[g * p->num_sections + k];
+    effp->clips += p->clips[g * p->num_sections + k];
+  }
+  return SOX_SUCCESS;
+}
+
+int lsx_biquad_stop(sox_effect_t * effp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t k;
+
+  if (p->num_sections > 1) {  /* Report clips as if not merged */
+    for (k = 0; k < p->num_sections; ++k) if (p->sections[k].clips) {
+      sox_globals.subsystem = p->sections[k].name;
+      lsx_warn_impl("%s clipped %" PRIu64 " samples; decrease volume?",
+          p->sections[k].name, p->sections[k].clips);
+    }
+    effp->clips = 0;
   }
+  free(p->sections);
+  free(p->mem);
+  free(p->clips);
+  p->sections = NULL, p->mem = NULL, p->clips = NULL;
+  p->num_sections = 0;
   return SOX_SUCCESS;
 }
 
@@ -171,8 +377,10 @@ static int create(sox_effect_t * effp, int argc, char * * argv)
 sox_effect_handler_t const * lsx_biquad_effect_fn(void)
 {
   static sox_effect_handler_t handler = {
-    "biquad", "b0 b1 b2 a0 a1 a2", 0,
-    create, lsx_biquad_start, lsx_biquad_flow, NULL, NULL, NULL, sizeof(priv_t)
+    "biquad", "b0 b1 b2 a0 a1 a2",
+    SOX_EFF_MCHAN | SOX_EFF_PLANAR | SOX_EFF_FLOAT | SOX_EFF_FUSE,
+    create, lsx_biquad_start, lsx_biquad_flow, NULL, lsx_biquad_stop, NULL,
+    sizeof(priv_t)
   };
   return &handler;
 }
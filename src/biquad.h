@@ -52,6 +52,13 @@ typedef enum {
   width_slope
 } width_t;
 
+/* One second-order section of a (possibly cascaded) biquad filter */
+typedef struct {
+  double b0, b1, b2, a1, a2; /* Coefficients, normalised so that a0 = 1 */
+  char const * name;       /* Of the effect that the section came from */
+  sox_uint64_t clips;      /* Clipped on output from this section */
+} biquad_section_t;
+
 /* Private data for the biquad filter effects */
 typedef struct {
   double gain;             /* For EQ filters */
@@ -64,8 +71,13 @@ typedef struct {
   double b0, b1, b2;       /* Filter coefficients */
   double a0, a1, a2;       /* Filter coefficients */
 
-  sox_sample_t i1, i2;     /* Filter memory */
-  double      o1, o2;      /* Filter memory */
+  /* The filter as run: this effect's section, followed by those of any
+   * following biquad effects merged in by lsx_biquad_absorb */
+  size_t num_sections;
+  biquad_section_t * sections;
+  double * mem;            /* i1, i2, o1, o2 per section, per channel */
+  sox_uint64_t * clips;    /* Per channel group, per section */
+  sox_bool float_link;     /* Sections exchange floats, not sox_sample_t */
 } biquad_t;
 
 int lsx_biquad_getopts(sox_effect_t * effp, int n, char **argv,
@@ -74,5 +86,6 @@ int lsx_biquad_getopts(sox_effect_t * effp, int n, char **argv,
 int lsx_biquad_start(sox_effect_t * effp);
 int lsx_biquad_flow(sox_effect_t * effp, const sox_sample_t *ibuf, sox_sample_t *obuf,
                         size_t *isamp, size_t *osamp);
+int lsx_biquad_stop(sox_effect_t * effp);
 
 #endif
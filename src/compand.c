@@ -34,9 +34,10 @@
  *                  -------
  */
 #define compand_usage \
-  "attack1,decay1{,attack2,decay2} [soft-knee-dB:]in-dB1[,out-dB1]{,in-dB2,out-dB2} [gain [initial-volume-dB [delay]]]\n" \
+  "[-e max-error-dB] attack1,decay1{,attack2,decay2} [soft-knee-dB:]in-dB1[,out-dB1]{,in-dB2,out-dB2} [gain [initial-volume-dB [delay]]]\n" \
   "\twhere {} means optional and repeatable and [] means optional.\n" \
-  "\tdB values are floating point or -inf'; times are in seconds."
+  "\tdB values are floating point or -inf'; times are in seconds.\n" \
+  "\t-e: maximum error of the table of gains; 0 for exact gains (.001)"
 /*
  * Note: clipping can occur if the transfer function pushes things too
  * close to 0 dB.  In that case, use a negative gain, or reduce the
@@ -45,6 +46,7 @@
 
 typedef struct {
   sox_compandt_t transfer_fn;
+  double max_error_dB;      /* Of the table of gains; 0 for none (exact) */
 
   struct {
     double attack_times[2]; /* 0:attack_time, 1:decay_time */
@@ -70,8 +72,16 @@ static int getopts(sox_effect_t * effp, int argc, char * * argv)
   char * s;
   char dummy;     /* To check for extraneous chars. */
   unsigned pairs, i, j, commas;
-
-  --argc, ++argv;
+  lsx_getopt_t optstate;
+  int c;
+
+  l->max_error_dB = LSX_COMPANDT_MAX_ERROR_DB;
+  lsx_getopt_init(argc, argv, "+e:", NULL, lsx_getopt_flag_none, 1, &optstate);
+  while ((c = lsx_getopt(&optstate)) != -1) switch (c) {
+    GETOPT_LOCAL_NUMERIC(optstate, 'e', l->max_error_dB, 0, 6)
+    default: lsx_fail("invalid option `-%c'", optstate.opt); return lsx_usage(effp);
+  }
+  argc -= optstate.ind, argv += optstate.ind;
   if (argc < 2 || argc > 5)
     return lsx_usage(effp);
 
@@ -146,6 +156,8 @@ static int start(sox_effect_t * effp)
         l->channels[i].attack_times[0], l->channels[i].attack_times[1]);
   if (!lsx_compandt_show(&l->transfer_fn, effp->global_info->plot))
     return SOX_EOF;
+  lsx_compandt_table(&l->transfer_fn,
+      l->max_error_dB, LSX_COMPANDT_MAX_PER_OCTAVE);
 
   /* Convert attack and decay rates using number of samples */
   for (i = 0; i < l->expectedChannels; ++i)
@@ -176,10 +188,10 @@ static void doVolume(double *v, double samp, priv_t * l, int chan)
   double s = -samp / SOX_SAMPLE_MIN;
   double delta = s - *v;
 
-  if (delta > 0.0) /* increase volume according to attack rate */
-    *v += delta * l->channels[chan].attack_times[0];
-  else             /* reduce volume according to decay rate */
-    *v += delta * l->channels[chan].attack_times[1];
+  /* Increase volume according to attack rate, or reduce it according to
+   * decay rate; a select rather than a branch, since audio makes the
+   * direction hard to predict */
+  *v += delta * l->channels[chan].attack_times[delta > 0.0? 0 : 1];
 }
 
 static int flow(sox_effect_t * effp, const sox_sample_t *ibuf, sox_sample_t *obuf,
@@ -189,6 +201,7 @@ static int flow(sox_effect_t * effp, const sox_sample_t *ibuf, sox_sample_t *obu
   int len =  (*isamp > *osamp) ? *osamp : *isamp;
   int filechans = effp->out_signal.channels;
   int idone,odone;
+  double level_out_lin = 0;
 
   for (idone = 0,odone = 0; idone < len; ibuf += filechans) {
     int chan;
@@ -212,10 +225,11 @@ static int flow(sox_effect_t * effp, const sox_sample_t *ibuf, sox_sample_t *obu
     /* Volume memory is updated: perform compand */
     for (chan = 0; chan < filechans; ++chan) {
       int ch = l->expectedChannels > 1 ? chan : 0;
-      double level_in_lin = l->channels[ch].volume;
-      double level_out_lin = lsx_compandt(&l->transfer_fn, level_in_lin);
       double checkbuf;
 
+      if (!chan || ch) /* Once per frame if channels are companded as one */
+        level_out_lin = lsx_compandt_lookup(&l->transfer_fn, l->channels[ch].volume);
+
       if (l->delay_buf_size <= 0) {
         checkbuf = ibuf[chan] * level_out_lin;
         SOX_SAMPLE_CLIP_COUNT(checkbuf, effp->clips);
@@ -254,7 +268,7 @@ static int drain(sox_effect_t * effp, sox_sample_t *obuf, size_t *osamp)
     for (chan = 0; chan < effp->out_signal.channels; ++chan) {
       int c = l->expectedChannels > 1 ? chan : 0;
       double level_in_lin = l->channels[c].volume;
-      double level_out_lin = lsx_compandt(&l->transfer_fn, level_in_lin);
+      double level_out_lin = lsx_compandt_lookup(&l->transfer_fn, level_in_lin);
       obuf[done++] = l->delay_buf[l->delay_buf_index++] * level_out_lin;
       l->delay_buf_index %= l->delay_buf_size;
       l->delay_buf_cnt--;
@@ -222,8 +222,76 @@ sox_bool lsx_compandt_parse(sox_compandt_t * t, char * points, char * gain)
   return sox_true;
 }
 
+/* Error (dB) at the given level of the gain from lsx_compandt_lookup */
+static double table_error(sox_compandt_t * t, double in_lin)
+{
+  return fabs(LOG_TO_LOG10(log(lsx_compandt_lookup(t, in_lin) /
+      lsx_compandt(t, in_lin))));
+}
+
+/* Makes the table for lsx_compandt_lookup, doubling the number of nodes per
+ * octave until the interpolated gain is within max_error_dB of that given by
+ * lsx_compandt at every level; if max_per_octave nodes aren't enough, there
+ * is no table, and lsx_compandt_lookup gives the exact gain.  The transfer
+ * function isn't smooth (nor, with soft knees, quite continuous) where its
+ * segments join, so the gain is calculated exactly between nodes either
+ * side of each join; elsewhere, the error peaks mid-way between nodes. */
+void lsx_compandt_table(sox_compandt_t * t, double max_error_dB,
+    unsigned max_per_octave)
+{
+  union {float f; sox_int32_t i;} lo, hi, x;
+  size_t j, len;
+  int i;
+
+  free(t->gains);
+  t->gains = NULL;
+  lo.f = (float)t->in_min_lin, hi.f = 1;
+  if (max_error_dB <= 0 || lo.f >= hi.f)
+    return;
+  for (t->gains_shift = 23 - 4; t->gains_shift > 0 &&
+      1u << (23 - t->gains_shift) <= max_per_octave; --t->gains_shift) {
+    double error = 0;
+    struct sox_compandt_node * gains;
+
+    t->gains_scale = 1. / (1 << t->gains_shift);
+    t->gains_base = lo.i & ~((1 << t->gains_shift) - 1);
+    len = ((hi.i - t->gains_base) >> t->gains_shift) + 1;
+    gains = lsx_malloc(len * sizeof(*gains));
+    for (j = 0; j < len; ++j) {
+      x.i = t->gains_base + (sox_int32_t)(j << t->gains_shift);
+      gains[j].gain = lsx_compandt(t, x.f);
+      if (j)
+        gains[j - 1].slope = gains[j].gain - gains[j - 1].gain;
+    }
+    gains[len - 1].slope = 0; /* Level 1 (full scale); not interpolated */
+    for (i = 1; t->segments[i - 1].x; ++i) {
+      x.f = (float)exp(t->segments[i].x);
+      for (j = 0; j < 2; ++j, --x.i) /* Guard against rounding the level */
+        if (x.i >= t->gains_base && x.i < hi.i)
+          gains[(x.i - t->gains_base) >> t->gains_shift].slope = HUGE_VAL;
+    }
+    t->gains = gains;
+
+    for (j = 0; j + 1 < len; ++j) {
+      x.i = t->gains_base + (sox_int32_t)(j << t->gains_shift) +
+          (1 << (t->gains_shift - 1));
+      error = max(error, table_error(t, x.f));
+    }
+    if (error <= max_error_dB) {
+      lsx_debug("gain table: %u nodes per octave (%" PRIuPTR " in all); "
+          "max error %g dB", 1u << (23 - t->gains_shift), len, error);
+      return;
+    }
+    free(t->gains);
+    t->gains = NULL;
+  }
+  lsx_debug("gain table: none within %g dB", max_error_dB);
+}
+
 void lsx_compandt_kill(sox_compandt_t * p)
 {
   free(p->segments);
+  free(p->gains);
+  p->gains = NULL;
 }
 
@@ -26,10 +26,22 @@ typedef struct {
   double out_min_lin;
   double outgain_dB;        /* Post processor gain */
   double curve_dB;
+  struct sox_compandt_node {
+    float gain, slope;      /* At node, & to next (HUGE_VAL: exact only) */
+  } * gains;                /* Gain table (see lsx_compandt_lookup), or NULL */
+  sox_int32_t gains_base;   /* Bits of the level (as a float) at gains[0] */
+  int gains_shift;          /* log2 of the level bits between table nodes */
+  double gains_scale;       /* 1 / (1 << gains_shift) */
 } sox_compandt_t;
 
+/* Defaults for lsx_compandt_table */
+#define LSX_COMPANDT_MAX_ERROR_DB    .001
+#define LSX_COMPANDT_MAX_PER_OCTAVE  1024
+
 sox_bool lsx_compandt_parse(sox_compandt_t * t, char * points, char * gain);
 sox_bool lsx_compandt_show(sox_compandt_t * t, sox_plot_t plot);
+void    lsx_compandt_table(sox_compandt_t * t, double max_error_dB,
+                           unsigned max_per_octave);
 void    lsx_compandt_kill(sox_compandt_t * p);
 
 /* Place in header to allow in-lining */
@@ -50,3 +62,27 @@ static double lsx_compandt(sox_compandt_t * t, double in_lin)
 
   return exp(out_log);
 }
+
+/* As lsx_compandt, but interpolated from the table made by
+ * lsx_compandt_table, if any.  The bits of a positive float are (to within
+ * a piecewise linear error) a scaled and offset log2 of its value, so give
+ * an index into a table of gains whose nodes are equally spaced in the log
+ * domain; between nodes, the gain is linearly interpolated. */
+static double lsx_compandt_lookup(sox_compandt_t * t, double in_lin)
+{
+  union {float f; sox_int32_t i;} level;
+  struct sox_compandt_node const * node;
+  sox_int32_t i;
+
+  if (in_lin <= t->in_min_lin)
+    return t->out_min_lin;
+  if (!t->gains || in_lin >= 1)
+    return lsx_compandt(t, in_lin);
+
+  level.f = (float)in_lin;
+  i = max(level.i - t->gains_base, 0);
+  node = t->gains + (i >> t->gains_shift);
+  if (node->slope == HUGE_VAL)
+    return lsx_compandt(t, in_lin);
+  return node->gain + (i & ((1 << t->gains_shift) - 1)) * t->gains_scale * node->slope;
+}
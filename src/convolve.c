@@ -0,0 +1,388 @@
+/* libSoX effect: convolve with an impulse response
+ * Copyright (c) 2026 SoX contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* The impulse response (IR) is read from an audio file by the format
+ * handlers, through the rate effect if its sample-rate differs from that of
+ * the audio.  Each IR channel is applied along one or more `paths' from an
+ * input to an output channel, by uniformly partitioned convolution (see
+ * dft_filter.c): each input channel's block is transformed once, into its
+ * frequency-domain delay line, and each output channel's once, back from
+ * the sum over the paths to it.  A resampled IR is scaled to keep its gain,
+ * and keeps the pre-ringing of rate's filter: the IR is padded first, and
+ * only the silence from the padding is then removed.  So the latency is one
+ * block, which is the partition length, or less for a short IR.  The IR's
+ * tail is output when the input ends. */
+
+#include "sox_i.h"
+#include "dft_filter.h"
+#include <string.h>
+
+typedef struct {size_t in, out, ir;} path_t; /* Channel numbers */
+
+typedef struct {
+  char const    * filename;
+  sox_bool      normalise;
+  double        gain_dB;
+
+  double        * ir;         /* As read: interleaved, ir_length frames */
+  size_t        ir_channels, ir_length, ir_size;
+
+  size_t        ichannels, ochannels, num_paths;
+  path_t        * paths;
+  dft_filter_t  * filters;    /* One per IR channel */
+  int           block, dft_length, num_parts, fdl_pos;
+  double        * fdl, * in, * out; /* For each in, in, out channel, resp. */
+  size_t        in_pos, out_pos, out_len;
+  uint64_t      samples_in, samples_out;
+} priv_t;
+
+static int getopts(sox_effect_t * effp, int argc, char * * argv)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  lsx_getopt_t optstate;
+  int c;
+
+  lsx_getopt_init(argc, argv, "+n", NULL, lsx_getopt_flag_none, 1, &optstate);
+  while ((c = lsx_getopt(&optstate)) != -1) switch (c) {
+    case 'n': p->normalise = sox_true; break;
+    default: lsx_fail("invalid option `-%c'", optstate.opt); return lsx_usage(effp);
+  }
+  argc -= optstate.ind, argv += optstate.ind;
+  if (!argc)
+    return lsx_usage(effp);
+  p->filename = *argv, --argc, ++argv;
+  do {NUMERIC_PARAMETER(gain_dB, -60, 60)} while (0);
+  return argc? lsx_usage(effp) : SOX_SUCCESS;
+}
+
+/*------------------- Reading the IR, via an effects chain -------------------*/
+
+static int ir_getopts(sox_effect_t * effp, int argc, char * * argv)
+{
+  if (argc != 2)
+    return SOX_EOF;
+  *(priv_t * *)effp->priv = (priv_t *)argv[1];
+  return SOX_SUCCESS;
+}
+
+static int ir_flow(sox_effect_t * effp, sox_sample_t const * ibuf,
+    sox_sample_t * obuf, size_t * isamp, size_t * osamp)
+{
+  priv_t * p = *(priv_t * *)effp->priv;
+  size_t i, n = p->ir_length * p->ir_channels;
+
+  if (n + *isamp > p->ir_size) {
+    p->ir_size = max(2 * p->ir_size, n + *isamp);
+    p->ir = lsx_realloc(p->ir, p->ir_size * sizeof(*p->ir));
+  }
+  for (i = 0; i < *isamp; ++i)
+    p->ir[n + i] = SOX_SAMPLE_TO_FLOAT_64BIT(ibuf[i], effp->clips);
+  p->ir_length += *isamp / p->ir_channels;
+  (void)obuf, *osamp = 0;
+  return SOX_SUCCESS;
+}
+
+static sox_effect_handler_t const ir_handler = {
+  "convolve", NULL, SOX_EFF_MCHAN | SOX_EFF_INTERNAL,
+  ir_getopts, NULL, ir_flow, NULL, NULL, NULL, sizeof(priv_t *)
+};
+
+static int add_effect(sox_effects_chain_t * chain,
+    sox_effect_handler_t const * handler, int argc, char * * argv,
+    sox_signalinfo_t * in, sox_signalinfo_t const * out)
+{
+  sox_effect_t * e = sox_create_effect(handler);
+  int result = sox_effect_options(e, argc, argv);
+
+  if (result == SOX_SUCCESS)
+    result = sox_add_effect(chain, e, in, out);
+  if (result != SOX_SUCCESS)
+    free(e->priv);
+  free(e);
+  return result;
+}
+
+/* Leading (or trailing) frames of the read IR that are silent in every
+ * channel, but for the round-off (a few LSBs) of rate's DFT stages */
+static size_t silent_frames(priv_t const * p, sox_bool trailing)
+{
+  size_t i, n = p->ir_length * p->ir_channels;
+
+  for (i = 0; i < n && fabs(p->ir[trailing? n - 1 - i : i]) <
+      4. / SOX_SAMPLE_MAX; ++i);
+  return i / p->ir_channels;
+}
+
+static int read_ir(sox_effect_t * effp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  sox_format_t * ft = sox_open_read(p->filename, NULL, NULL, NULL);
+  sox_effects_chain_t * chain;
+  sox_signalinfo_t signal, out;
+  size_t i, pad = 0;
+  double ratio = 1;
+  char arg[32], * args[2], * arg_ft = (char *)ft;
+  int result;
+
+  if (!ft)
+    return SOX_EOF;
+  signal = out = ft->signal;
+  out.rate = effp->in_signal.rate;
+  p->ir_channels = signal.channels;
+  chain = sox_create_effects_chain(&ft->encoding, &ft->encoding);
+  result = add_effect(chain, sox_find_effect("input"), 1, &arg_ft, &signal, &signal);
+  if (result == SOX_SUCCESS && signal.rate != out.rate) {
+    lsx_report("resampling impulse response from %gHz", signal.rate);
+    ratio = out.rate / signal.rate;
+    pad = (size_t)ceil(signal.rate * .1); /* > rate's filter half-length */
+    sprintf(arg, "%" PRIuPTR "s", pad);
+    args[0] = args[1] = arg; /* At the start and at the end */
+    result = add_effect(chain, sox_find_effect("pad"), 2, args, &signal, &signal);
+    if (result == SOX_SUCCESS)
+      result = add_effect(chain, sox_find_effect("rate"), 0, NULL, &signal, &out);
+  }
+  if (result == SOX_SUCCESS) {
+    args[0] = (char *)p;
+    result = add_effect(chain, &ir_handler, 1, args, &signal, &signal);
+  }
+  if (result == SOX_SUCCESS)
+    result = sox_flow_effects(chain, NULL, NULL);
+  if (result == SOX_SUCCESS && sox_effects_clips(chain))
+    lsx_warn("impulse response clipped when resampled");
+  sox_delete_effects_chain(chain);
+  sox_close(ft);
+  if (result == SOX_SUCCESS && ratio != 1) {
+    size_t n, drop = min(silent_frames(p, sox_false), (size_t)(pad * ratio));
+
+    if (!drop && p->ir_length)
+      lsx_warn("resampled impulse response may have lost its pre-ringing");
+    p->ir_length -= drop;
+    memmove(p->ir, p->ir + drop * p->ir_channels,
+        p->ir_length * p->ir_channels * sizeof(*p->ir));
+    p->ir_length -= min(silent_frames(p, sox_true), (size_t)(pad * ratio));
+    n = p->ir_length * p->ir_channels;
+    for (i = 0; i < n; ++i) /* So that the sum of the taps is kept */
+      p->ir[i] /= ratio;
+  }
+  if (result == SOX_SUCCESS && !p->ir_length) {
+    lsx_fail("impulse response `%s' is empty", p->filename);
+    result = SOX_EOF;
+  }
+  return result;
+}
+
+/*--------------------------------- Effect -----------------------------------*/
+
+static int start(sox_effect_t * effp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t i, c, channels = effp->in_signal.channels;
+  double * h, scale = dB_to_linear(p->gain_dB), power = 0;
+  int part_length = 1 << sox_globals.log2_dft_partition_size;
+
+  if (read_ir(effp) != SOX_SUCCESS) {
+    free(p->ir), p->ir = NULL;
+    return SOX_EOF;
+  }
+
+  p->ichannels = p->ochannels = channels;
+  if (p->ir_channels == 1 || p->ir_channels == channels) {
+    p->paths = lsx_calloc(p->num_paths = channels, sizeof(*p->paths));
+    for (c = 0; c < channels; ++c) {
+      p->paths[c].in = p->paths[c].out = c;
+      p->paths[c].ir = p->ir_channels == 1? 0 : c;
+    }
+  }
+  else if (p->ir_channels == 2 * channels && channels <= 2) {
+    /* Mono to stereo: L, R; or true stereo: L to L, L to R, R to L, R to R */
+    p->ochannels = 2;
+    p->paths = lsx_calloc(p->num_paths = p->ir_channels, sizeof(*p->paths));
+    for (i = 0; i < p->num_paths; ++i) {
+      p->paths[i].in = i >> 1;
+      p->paths[i].out = i & 1;
+      p->paths[i].ir = i;
+    }
+  }
+  else {
+    lsx_fail("can't apply a %" PRIuPTR "-channel impulse response to %" PRIuPTR
+        "-channel audio", p->ir_channels, channels);
+    free(p->ir), p->ir = NULL;
+    return SOX_EOF;
+  }
+  effp->out_signal.channels = p->ochannels;
+  if (effp->in_signal.length != SOX_UNKNOWN_LEN)
+    effp->out_signal.length = (effp->in_signal.length / p->ichannels +
+        p->ir_length - 1) * p->ochannels;
+  else effp->out_signal.length = SOX_UNKNOWN_LEN;
+
+  if (p->normalise) { /* Unity gain for white noise, to the loudest output */
+    for (c = 0; c < p->ochannels; ++c) {
+      double sum = 0;
+      for (i = 0; i < p->num_paths; ++i) if (p->paths[i].out == c) {
+        size_t j, k = p->paths[i].ir;
+        for (j = 0; j < p->ir_length; ++j)
+          sum += sqr(p->ir[j * p->ir_channels + k]);
+      }
+      power = max(power, sum);
+    }
+    if (power)
+      scale /= sqrt(power);
+    lsx_debug("normalising by %g", scale);
+  }
+
+  for (p->block = 16; p->block < part_length &&
+      (size_t)p->block < p->ir_length; p->block <<= 1);
+  h = lsx_malloc(p->ir_length * sizeof(*h));
+  p->filters = lsx_calloc(p->ir_channels, sizeof(*p->filters));
+  for (c = 0; c < p->ir_channels; ++c) {
+    for (i = 0; i < p->ir_length; ++i)
+      h[i] = p->ir[i * p->ir_channels + c] * scale;
+    lsx_set_dft_partitions(&p->filters[c], h, (int)p->ir_length, p->block);
+  }
+  free(h);
+  free(p->ir), p->ir = NULL;
+  p->dft_length = p->filters[0].dft_length;
+  p->num_parts = p->filters[0].num_parts;
+  lsx_report("%" PRIuPTR " paths of %" PRIuPTR " taps; latency %i samples",
+      p->num_paths, p->ir_length, p->block);
+
+  p->fdl = lsx_calloc(p->ichannels * p->num_parts * p->dft_length, sizeof(*p->fdl));
+  p->in = lsx_calloc(p->ichannels * p->dft_length, sizeof(*p->in));
+  p->out = lsx_calloc(p->ochannels * p->dft_length, sizeof(*p->out));
+  p->fdl_pos = 0;
+  p->in_pos = p->out_pos = p->out_len = 0;
+  p->samples_in = p->samples_out = 0;
+  return SOX_SUCCESS;
+}
+
+static void convolve_block(priv_t * p)
+{
+  size_t c, i, n = p->dft_length, spectra = p->num_parts * n;
+
+  for (c = 0; c < p->ichannels; ++c) {
+    double * in = p->in + c * n, * spectrum = p->fdl + c * spectra + p->fdl_pos * n;
+    memcpy(spectrum, in, n * sizeof(*spectrum));
+    lsx_safe_rdft((int)n, 1, spectrum);
+    memcpy(in, in + p->block, p->block * sizeof(*in)); /* Now the previous */
+  }
+  memset(p->out, 0, p->ochannels * n * sizeof(*p->out));
+  for (i = 0; i < p->num_paths; ++i) {
+    path_t const * path = &p->paths[i];
+    lsx_dft_partitions_mac(&p->filters[path->ir], p->fdl + path->in * spectra,
+        p->fdl_pos, p->out + path->out * n);
+  }
+  for (c = 0; c < p->ochannels; ++c) /* The 1st half is aliased */
+    lsx_safe_rdft((int)n, -1, p->out + c * n);
+  p->fdl_pos = (p->fdl_pos + 1) % p->num_parts;
+  p->in_pos = p->out_pos = 0;
+  p->out_len = p->block;
+}
+
+/* Output up to len frames, at obuf frame number done */
+static size_t output(sox_effect_t * effp, sox_sample_t * obuf, size_t done,
+    size_t len)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t stride = effp->planar? lsx_plane_size(p->ochannels) : 1;
+  size_t step = effp->planar? 1 : p->ochannels, c, i;
+  SOX_SAMPLE_LOCALS;
+
+  len = min(len, p->out_len - p->out_pos);
+  for (c = 0; c < p->ochannels; ++c) {
+    double const * out = p->out + c * p->dft_length + p->block + p->out_pos;
+    sox_sample_t * o = obuf + c * stride + done * step;
+    for (i = 0; i < len; ++i, o += step)
+      *o = SOX_FLOAT_64BIT_TO_SAMPLE(out[i], effp->clips);
+  }
+  p->out_pos += len;
+  p->samples_out += len;
+  return len;
+}
+
+static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
+    sox_sample_t * obuf, size_t * isamp, size_t * osamp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t stride = effp->planar? lsx_plane_size(p->ichannels) : 1;
+  size_t step = effp->planar? 1 : p->ichannels, c, i, n;
+  size_t ilen = *isamp / p->ichannels, olen = *osamp / p->ochannels;
+  size_t idone = 0, odone = 0;
+
+  for (;;) {
+    odone += output(effp, obuf, odone, olen - odone);
+    if (p->out_pos < p->out_len || idone == ilen)
+      break;
+    n = min(ilen - idone, p->block - p->in_pos);
+    for (c = 0; c < p->ichannels; ++c) {
+      double * in = p->in + c * p->dft_length + p->block + p->in_pos;
+      sox_sample_t const * s = ibuf + c * stride + idone * step;
+      for (i = 0; i < n; ++i, s += step)
+        in[i] = SOX_SAMPLE_TO_FLOAT_64BIT(*s, effp->clips);
+    }
+    idone += n, p->in_pos += n;
+    p->samples_in += n;
+    if (p->in_pos == (size_t)p->block)
+      convolve_block(p);
+  }
+  *isamp = idone * p->ichannels, *osamp = odone * p->ochannels;
+  return SOX_SUCCESS;
+}
+
+static int drain(sox_effect_t * effp, sox_sample_t * obuf, size_t * osamp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  uint64_t length = p->samples_in + p->ir_length - 1; /* With the tail */
+  size_t c, olen = *osamp / p->ochannels, odone = 0;
+
+  while (odone < olen && p->samples_out < length) {
+    if (p->out_pos == p->out_len) { /* Complete the block with silence */
+      for (c = 0; c < p->ichannels; ++c)
+        memset(p->in + c * p->dft_length + p->block + p->in_pos, 0,
+            (p->block - p->in_pos) * sizeof(*p->in));
+      convolve_block(p);
+    }
+    odone += output(effp, obuf, odone,
+        (size_t)min(olen - odone, length - p->samples_out));
+  }
+  *osamp = odone * p->ochannels;
+  return SOX_SUCCESS;
+}
+
+static int stop(sox_effect_t * effp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t c;
+
+  for (c = 0; c < p->ir_channels; ++c)
+    free(p->filters[c].coefs);
+  free(p->filters);
+  free(p->paths);
+  free(p->fdl);
+  free(p->in);
+  free(p->out);
+  return SOX_SUCCESS;
+}
+
+sox_effect_handler_t const * lsx_convolve_effect_fn(void)
+{
+  static sox_effect_handler_t handler = {"convolve", "[-n] IR-file [gain-dB]",
+    SOX_EFF_MCHAN | SOX_EFF_CHAN | SOX_EFF_LENGTH | SOX_EFF_GAIN |
+    SOX_EFF_PLANAR, getopts, start, flow, drain, stop, NULL, sizeof(priv_t)
+  };
+  return &handler;
+}
@@ -19,34 +19,134 @@
 #include "fft4g.h"
 #include "dft_filter.h"
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef dft_filter_t filter_t;
 typedef dft_filter_priv_t priv_t;
 
+/* A filter with more taps than 1 << sox_globals.log2_dft_partition_size is
+ * split into partitions of that many taps, each applied by overlap-save to
+ * a block of the same length, with the partitions' contributions summed in
+ * the frequency domain over the spectra of the most recent input blocks (a
+ * frequency-domain delay line).  This keeps the DFT length, and so the
+ * working set, independent of the filter length. */
+
+void lsx_set_dft_partitions(dft_filter_t * f, double const * h, int n,
+    int part_length)
+{
+  int i, j;
+
+  f->num_taps = n;
+  f->num_parts = (n + part_length - 1) / part_length;
+  f->dft_length = part_length * 2;
+  f->coefs = lsx_calloc((size_t)f->num_parts * f->dft_length, sizeof(*f->coefs));
+  for (j = 0; j < f->num_parts; ++j) {
+    double * coefs = f->coefs + (size_t)j * f->dft_length;
+    for (i = 0; i < part_length && j * part_length + i < n; ++i)
+      coefs[i] = h[j * part_length + i] / f->dft_length * 2;
+    lsx_safe_rdft(f->dft_length, 1, coefs);
+  }
+  lsx_debug("%i taps in %i partitions", n, f->num_parts);
+}
+
+void lsx_dft_partitions_mac(dft_filter_t const * f, double const * fdl,
+    int fdl_pos, double * output)
+{
+  int i, j;
+#ifdef __SSE2__
+  __m128d const neg = _mm_set_pd(0., -0.);
+#endif
+
+  for (j = 0; j < f->num_parts; ++j) {
+    double const * x = fdl + (size_t)
+      ((fdl_pos - j + f->num_parts) % f->num_parts) * f->dft_length;
+    double const * coefs = f->coefs + (size_t)j * f->dft_length;
+    output[0] += coefs[0] * x[0];
+    output[1] += coefs[1] * x[1];
+#ifdef __SSE2__
+    for (i = 2; i < f->dft_length; i += 2) { /* As below, term by term */
+      __m128d c = _mm_loadu_pd(coefs + i), z = _mm_loadu_pd(x + i);
+      __m128d re = _mm_mul_pd(z, _mm_unpacklo_pd(c, c));
+      __m128d im = _mm_mul_pd(_mm_shuffle_pd(z, z, 1), _mm_unpackhi_pd(c, c));
+      _mm_storeu_pd(output + i, _mm_add_pd(_mm_loadu_pd(output + i),
+            _mm_add_pd(re, _mm_xor_pd(im, neg))));
+    }
+#else
+    for (i = 2; i < f->dft_length; i += 2) {
+      output[i  ] += coefs[i  ] * x[i] - coefs[i+1] * x[i+1];
+      output[i+1] += coefs[i+1] * x[i] + coefs[i  ] * x[i+1];
+    }
+#endif
+  }
+}
+
 void lsx_set_dft_filter(dft_filter_t *f, double *h, int n, int post_peak)
 {
-  int i;
+  int i, part_length = 1 << sox_globals.log2_dft_partition_size;
+
   f->num_taps = n;
   f->post_peak = post_peak;
-  f->dft_length = lsx_set_dft_length(f->num_taps);
-  f->coefs = lsx_calloc(f->dft_length, sizeof(*f->coefs));
-  for (i = 0; i < f->num_taps; ++i)
-    f->coefs[(i + f->dft_length - f->num_taps + 1) & (f->dft_length - 1)] = h[i] / f->dft_length * 2;
-  lsx_safe_rdft(f->dft_length, 1, f->coefs);
+  if (n <= part_length) {
+    f->num_parts = 0;
+    f->dft_length = lsx_set_dft_length(f->num_taps);
+    f->coefs = lsx_calloc(f->dft_length, sizeof(*f->coefs));
+    for (i = 0; i < f->num_taps; ++i)
+      f->coefs[(i + f->dft_length - f->num_taps + 1) & (f->dft_length - 1)] = h[i] / f->dft_length * 2;
+    lsx_safe_rdft(f->dft_length, 1, f->coefs);
+  }
+  else lsx_set_dft_partitions(f, h, n, part_length);
   free(h);
 }
 
 static int start(sox_effect_t * effp)
 {
   priv_t * p = (priv_t *) effp->priv;
+  filter_t const * f = p->filter_ptr;
+  int pre = f->num_parts? f->dft_length >> 1 : f->post_peak;
 
   fifo_create(&p->input_fifo, (int)sizeof(double));
-  memset(fifo_reserve(&p->input_fifo,
-        p->filter_ptr->post_peak), 0, sizeof(double) * p->filter_ptr->post_peak);
+  memset(fifo_reserve(&p->input_fifo, pre), 0, sizeof(double) * pre);
   fifo_create(&p->output_fifo, (int)sizeof(double));
+  if (f->num_parts) {
+    p->fdl = lsx_calloc((size_t)f->num_parts * f->dft_length, sizeof(*p->fdl));
+    p->fdl_pos = 0;
+    p->skip = f->num_taps - 1 - f->post_peak;
+  }
   return SOX_SUCCESS;
 }
 
+static void filter_partitioned(priv_t * p)
+{
+  int i, num_in = max(0, fifo_occupancy(&p->input_fifo));
+  filter_t const * f = p->filter_ptr;
+  int const part_length = f->dft_length >> 1;
+  double * output;
+
+  while (num_in >= f->dft_length) {
+    double const * input = fifo_read_ptr(&p->input_fifo);
+    double * spectrum = p->fdl + (size_t)p->fdl_pos * f->dft_length;
+    fifo_read(&p->input_fifo, part_length, NULL);
+    num_in -= part_length;
+
+    memcpy(spectrum, input, f->dft_length * sizeof(*spectrum));
+    lsx_safe_rdft(f->dft_length, 1, spectrum);
+
+    output = fifo_reserve(&p->output_fifo, f->dft_length);
+    memset(output, 0, f->dft_length * sizeof(*output));
+    lsx_dft_partitions_mac(f, p->fdl, p->fdl_pos, output);
+    p->fdl_pos = (p->fdl_pos + 1) % f->num_parts;
+    lsx_safe_rdft(f->dft_length, -1, output);
+
+    /* The 1st half is aliased; of the 2nd, skip any samples before the peak */
+    i = min(p->skip, part_length);
+    p->skip -= i;
+    memmove(output, output + part_length + i, (part_length - i) * sizeof(*output));
+    fifo_trim_by(&p->output_fifo, part_length + i);
+  }
+}
+
 static void filter(priv_t * p)
 {
   int i, num_in = max(0, fifo_occupancy(&p->input_fifo));
@@ -54,6 +154,10 @@ static void filter(priv_t * p)
   int const overlap = f->num_taps - 1;
   double * output;
 
+  if (f->num_parts) {
+    filter_partitioned(p);
+    return;
+  }
   while (num_in >= f->dft_length) {
     double const * input = fifo_read_ptr(&p->input_fifo);
     fifo_read(&p->input_fifo, f->dft_length - overlap, NULL);
@@ -82,13 +186,13 @@ static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
   size_t odone = min(*osamp, (size_t)fifo_occupancy(&p->output_fifo));
 
   double const * s = fifo_read(&p->output_fifo, (int)odone, NULL);
-  lsx_save_samples(obuf, s, odone, &effp->clips);
+  lsx_effect_save_samples(effp, obuf, s, odone);
   p->samples_out += odone;
 
   if (*isamp && odone < *osamp) {
     double * t = fifo_write(&p->input_fifo, (int)*isamp, NULL);
     p->samples_in += *isamp;
-    lsx_load_samples(t, ibuf, *isamp);
+    lsx_effect_load_samples(effp, t, ibuf, *isamp);
     filter(p);
   }
   else *isamp = 0;
@@ -123,6 +227,8 @@ static int stop(sox_effect_t * effp)
 
   fifo_delete(&p->input_fifo);
   fifo_delete(&p->output_fifo);
+  free(p->fdl);
+  p->fdl = NULL;
   free(p->filter_ptr->coefs);
   memset(p->filter_ptr, 0, sizeof(*p->filter_ptr));
   return SOX_SUCCESS;
@@ -131,7 +237,7 @@ static int stop(sox_effect_t * effp)
 sox_effect_handler_t const * lsx_dft_filter_effect_fn(void)
 {
   static sox_effect_handler_t handler = {
-    NULL, NULL, SOX_EFF_GAIN, NULL, start, flow, drain, stop, NULL, 0
+    NULL, NULL, SOX_EFF_GAIN | SOX_EFF_FLOAT, NULL, start, flow, drain, stop, NULL, 0
   };
   return &handler;
 }
@@ -4,6 +4,7 @@
 
 typedef struct {
   int        dft_length, num_taps, post_peak;
+  int        num_parts;   /* If non-0, coefs holds this many partitions */
   double     * coefs;
 } dft_filter_t;
 
@@ -11,6 +12,18 @@ typedef struct {
   uint64_t   samples_in, samples_out;
   fifo_t     input_fifo, output_fifo;
   dft_filter_t   filter, * filter_ptr;
+  double     * fdl;       /* Partitioned: spectra of recent input blocks */
+  int        fdl_pos, skip;
 } dft_filter_priv_t;
 
 void lsx_set_dft_filter(dft_filter_t * f, double * h, int n, int post_peak);
+
+/* Set f to apply h (n taps, left to the caller to free) in partitions of
+ * part_length taps, to blocks of part_length samples; then, for each block,
+ * given fdl, a ring of the spectra of the last num_parts blocks (each with
+ * its predecessor, so dft_length samples) and the index of the newest,
+ * add to output the spectrum of f's response to the block. */
+void lsx_set_dft_partitions(dft_filter_t * f, double const * h, int n,
+    int part_length);
+void lsx_dft_partitions_mac(dft_filter_t const * f, double const * fdl,
+    int fdl_pos, double * output);
@@ -22,6 +22,12 @@
 #ifdef HAVE_STRINGS_H
   #include <strings.h>
 #endif
+#ifdef HAVE_SCHED_YIELD
+  #include <sched.h>
+#endif
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
 
 #define DEBUG_EFFECTS_CHAIN 0
 
@@ -95,6 +101,7 @@ sox_effects_chain_t * sox_create_effects_chain(
   result->global_info = *sox_get_effects_globals();
   result->in_enc = in_enc;
   result->out_enc = out_enc;
+  result->planar = sox_true;
   return result;
 } /* sox_create_effects_chain */
 
@@ -229,14 +236,57 @@ int sox_add_effect(sox_effects_chain_t * chain, sox_effect_t * effp, sox_signali
  * at position obeg/flows and ends before oend/flows.  In case bufsiz
  * is not evenly divisible by flows, there will be an unused area at
  * the very end of the output buffer.
+ * An effect flagged SOX_EFF_PLANAR handles all channels at once (flows
+ * = 1) but, if the chain allows it (chain->planar), is given its input
+ * and writes its output in the uninterleaved form, with one channel
+ * buffer per channel.
  * The interleave() and deinterleave() functions convert between these
  * two representations.
+ * If the chain allows it (chain->float_samples), adjacent effects that are
+ * both flagged SOX_EFF_FLOAT pass floats (full scale = 1, unclipped) rather
+ * than sox_sample_t in the same buffers; see sox_effect_t.in_float.
  */
 static void interleave(size_t flows, size_t length, sox_sample_t *from,
     size_t bufsiz, size_t offset, sox_sample_t *to);
 static void deinterleave(size_t flows, size_t length, sox_sample_t *from,
     sox_sample_t *to, size_t bufsiz, size_t offset);
 
+/* Number of threads across which to spread the flows of an effect when
+ * processing the given number of samples; 1 if not worth the fork/join. */
+static int flow_threads(sox_effect_t const * effp, size_t samples)
+{
+  size_t threads = sox_globals.num_threads?
+      sox_globals.num_threads : (size_t)omp_get_max_threads();
+
+  if (!sox_globals.use_threads || samples < sox_globals.threads_min_samples)
+    return 1;
+  return (int)min(threads, effp->flows);
+}
+
+/* Number of channel buffers that the input to effect n is split into
+ * (1 if interleaved); also used for the input to the (absent) effect after
+ * the last one, which is always interleaved. */
+static size_t in_planes(sox_effects_chain_t const * chain, size_t n)
+{
+  sox_effect_t const * effp = n < chain->length? chain->effects[n] : NULL;
+  return !effp? 1 : effp->planar? effp->in_signal.channels : effp->flows;
+}
+
+/* As in_planes, but for the output of an effect */
+static size_t out_planes(sox_effect_t const * effp)
+{
+  return effp->planar? effp->out_signal.channels : effp->flows;
+}
+
+/* Whether effects n and n + 1 exchange float samples rather than
+ * sox_sample_t; both being 4 bytes, buffer handling is unaffected. */
+static sox_bool float_link(sox_effects_chain_t const * chain, size_t n)
+{
+  return chain->float_samples && n + 1 < chain->length &&
+      (chain->effects[n]->handler.flags & SOX_EFF_FLOAT) &&
+      (chain->effects[n + 1]->handler.flags & SOX_EFF_FLOAT);
+}
+
 static int flow_effect(sox_effects_chain_t * chain, size_t n)
 {
   sox_effect_t *effp1 = chain->effects[n - 1];
@@ -245,40 +295,46 @@ static int flow_effect(sox_effects_chain_t * chain, size_t n)
   size_t f = 0;
   size_t idone = effp1->oend - effp1->obeg;
   size_t obeg = sox_globals.bufsiz - effp->oend;
-  sox_bool il_change = (effp->flows == 1) !=
-      (chain->length == n + 1 || chain->effects[n+1]->flows == 1);
+  size_t iplanes = in_planes(chain, n), oplanes = out_planes(effp);
+  size_t next_planes = in_planes(chain, n + 1);
+  sox_bool il_change = (oplanes == 1) != (next_planes == 1);
 #if DEBUG_EFFECTS_CHAIN
   size_t pre_idone = idone;
   size_t pre_odone = obeg;
 #endif
 
   if (effp->flows == 1) {     /* Run effect on all channels at once */
+    sox_sample_t *obuf = !il_change? effp->obuf + effp->oend / oplanes :
+        oplanes == 1? chain->il_buf : chain->il_buf + effp->oend / oplanes;
     idone -= idone % effp->in_signal.channels;
-    effstatus = effp->handler.flow(effp, effp1->obuf + effp1->obeg,
-                    il_change ? chain->il_buf : effp->obuf + effp->oend,
-                    &idone, &obeg);
+    effstatus = effp->handler.flow(effp, effp1->obuf + effp1->obeg / iplanes,
+                    obuf, &idone, &obeg);
     if (obeg % effp->out_signal.channels != 0) {
       lsx_fail("multi-channel effect flowed asymmetrically!");
       effstatus = SOX_EOF;
     }
-    if (il_change)
-      deinterleave(chain->effects[n+1]->flows, obeg, chain->il_buf,
+    if (il_change && oplanes == 1)
+      deinterleave(next_planes, obeg, chain->il_buf,
           effp->obuf, sox_globals.bufsiz, effp->oend);
+    else if (il_change)
+      interleave(oplanes, obeg, chain->il_buf, sox_globals.bufsiz,
+          effp->oend, effp->obuf + effp->oend);
   } else {               /* Run effect on each channel individually */
     sox_sample_t *obuf = il_change ? chain->il_buf : effp->obuf;
     size_t flow_offs = sox_globals.bufsiz/effp->flows;
     size_t idone_min = SOX_SIZE_MAX, idone_max = 0;
     size_t odone_min = SOX_SIZE_MAX, odone_max = 0;
+    int threads = flow_threads(effp, idone);
 
 #ifdef HAVE_OPENMP_3_1
     #pragma omp parallel for \
-        if(sox_globals.use_threads) \
+        if(threads > 1) num_threads(threads) \
         schedule(static) default(none) \
         shared(effp,effp1,idone,obeg,obuf,flow_offs,chain,n,effstatus) \
         reduction(min:idone_min,odone_min) reduction(max:idone_max,odone_max)
 #elif defined HAVE_OPENMP
     #pragma omp parallel for \
-        if(sox_globals.use_threads) \
+        if(threads > 1) num_threads(threads) \
         schedule(static) default(none) \
         shared(effp,effp1,idone,obeg,obuf,flow_offs,chain,n,effstatus) \
         firstprivate(idone_min,odone_min,idone_max,odone_max) \
@@ -313,11 +369,11 @@ static int flow_effect(sox_effects_chain_t * chain, size_t n)
   if (effp1->obeg == effp1->oend)
     effp1->obeg = effp1->oend = 0;
   else if (effp1->oend - effp1->obeg < effp->imin) { /* Need to refill? */
-    size_t flow_offs = sox_globals.bufsiz/effp->flows;
-    for (f = 0; f < effp->flows; ++f)
+    size_t flow_offs = sox_globals.bufsiz/iplanes;
+    for (f = 0; f < iplanes; ++f)
       memcpy(effp1->obuf + f * flow_offs,
-          effp1->obuf + f * flow_offs + effp1->obeg/effp->flows,
-          (effp1->oend - effp1->obeg)/effp->flows * sizeof(*effp1->obuf));
+          effp1->obuf + f * flow_offs + effp1->obeg/iplanes,
+          (effp1->oend - effp1->obeg)/iplanes * sizeof(*effp1->obuf));
     effp1->oend -= effp1->obeg;
     effp1->obeg = 0;
   }
@@ -342,44 +398,71 @@ static int drain_effect(sox_effects_chain_t * chain, size_t n)
   int effstatus = SOX_SUCCESS;
   size_t f = 0;
   size_t obeg = sox_globals.bufsiz - effp->oend;
-  sox_bool il_change = (effp->flows == 1) !=
-      (chain->length == n + 1 || chain->effects[n+1]->flows == 1);
+  size_t oplanes = out_planes(effp), next_planes = in_planes(chain, n + 1);
+  sox_bool il_change = (oplanes == 1) != (next_planes == 1);
 #if DEBUG_EFFECTS_CHAIN
   size_t pre_odone = obeg;
 #endif
 
   if (effp->flows == 1) { /* Run effect on all channels at once */
-    effstatus = effp->handler.drain(effp,
-                    il_change ? chain->il_buf : effp->obuf + effp->oend,
-                    &obeg);
+    sox_sample_t *obuf = !il_change? effp->obuf + effp->oend / oplanes :
+        oplanes == 1? chain->il_buf : chain->il_buf + effp->oend / oplanes;
+    effstatus = effp->handler.drain(effp, obuf, &obeg);
     if (obeg % effp->out_signal.channels != 0) {
       lsx_fail("multi-channel effect drained asymmetrically!");
       effstatus = SOX_EOF;
     }
-    if (il_change)
-      deinterleave(chain->effects[n+1]->flows, obeg, chain->il_buf,
+    if (il_change && oplanes == 1)
+      deinterleave(next_planes, obeg, chain->il_buf,
           effp->obuf, sox_globals.bufsiz, effp->oend);
+    else if (il_change)
+      interleave(oplanes, obeg, chain->il_buf, sox_globals.bufsiz,
+          effp->oend, effp->obuf + effp->oend);
   } else {                       /* Run effect on each channel individually */
     sox_sample_t *obuf = il_change ? chain->il_buf : effp->obuf;
     size_t flow_offs = sox_globals.bufsiz/effp->flows;
-    size_t odone_last = 0; /* Initialised to prevent warning */
+    size_t odone_min, odone_max = obeg / effp->flows;
+    int threads;
+
+    /* How much a drain will give is not known until it is done, but it is
+     * the same for each flow; so drain the first, then use what that gave
+     * to decide whether the others are worth spreading across threads. */
+    if (effp->handler.drain(&chain->effects[n][0],
+          obuf + effp->oend/effp->flows, &odone_max) != SOX_SUCCESS)
+      effstatus = SOX_EOF;
+    odone_min = odone_max;
+    threads = flow_threads(effp, effp->flows * odone_max);
 
-    for (f = 0; f < effp->flows; ++f) {
+#ifdef HAVE_OPENMP_3_1
+    #pragma omp parallel for \
+        if(threads > 1) num_threads(threads) \
+        schedule(static) default(none) \
+        shared(effp,obeg,obuf,flow_offs,chain,n,effstatus) \
+        reduction(min:odone_min) reduction(max:odone_max)
+#elif defined HAVE_OPENMP
+    #pragma omp parallel for \
+        if(threads > 1) num_threads(threads) \
+        schedule(static) default(none) \
+        shared(effp,obeg,obuf,flow_offs,chain,n,effstatus) \
+        firstprivate(odone_min,odone_max) \
+        lastprivate(odone_min,odone_max)
+#endif
+    for (f = 1; f < effp->flows; ++f) {
       size_t odonec = obeg / effp->flows;
       int eff_status_c = effp->handler.drain(&chain->effects[n][f],
           obuf + f*flow_offs + effp->oend/effp->flows,
           &odonec);
-      if (f && (odonec != odone_last)) {
-        lsx_fail("drained asymmetrically!");
-        effstatus = SOX_EOF;
-      }
-      odone_last = odonec;
+      odone_min = min(odonec, odone_min); odone_max = max(odonec, odone_max);
 
       if (eff_status_c != SOX_SUCCESS)
         effstatus = SOX_EOF;
     }
 
-    obeg = effp->flows * odone_last;
+    if (odone_min != odone_max) {
+      lsx_fail("drained asymmetrically!");
+      effstatus = SOX_EOF;
+    }
+    obeg = effp->flows * odone_max;
 
     if (il_change)
       interleave(effp->flows, obeg, chain->il_buf, sox_globals.bufsiz,
@@ -399,16 +482,23 @@ static int drain_effect(sox_effects_chain_t * chain, size_t n)
   return effstatus == SOX_SUCCESS? SOX_SUCCESS : SOX_EOF;
 }
 
-/* Flow data through the effects chain until an effect or callback gives EOF */
-int sox_flow_effects(sox_effects_chain_t * chain, int (* callback)(sox_bool all_done, void * client_data), void * client_data)
+/* Flow data through the effects chain on the calling thread */
+static int flow_effects_serial(sox_effects_chain_t * chain, int (* callback)(sox_bool all_done, void * client_data), void * client_data)
 {
   int flow_status = SOX_SUCCESS;
   size_t e, source_e = 0;               /* effect indices */
-  size_t max_flows = 0;
+  size_t max_planes = 0;
   sox_bool draining = sox_true;
 
   for (e = 0; e < chain->length; ++e) {
     sox_effect_t *effp = chain->effects[e];
+    size_t f;
+    effp->planar = chain->planar && effp->flows == 1 &&
+        (effp->handler.flags & SOX_EFF_PLANAR);
+    for (f = 0; f < effp->flows; ++f) {
+      effp[f].in_float = e && float_link(chain, e - 1);
+      effp[f].out_float = float_link(chain, e);
+    }
     effp->obuf =
         lsx_realloc(effp->obuf, sox_globals.bufsiz * sizeof(*effp->obuf));
       /* Memory will be freed by sox_delete_effect() later. */
@@ -419,9 +509,9 @@ int sox_flow_effects(sox_effects_chain_t * chain, int (* callback)(sox_bool all_
         /* can only happen if bufsize has been reduced since the last run */
         effp->obeg = effp->oend = 0;
       }
-    max_flows = max(max_flows, effp->flows);
+    max_planes = max(max_planes, max(out_planes(effp), in_planes(chain, e)));
   }
-  if (max_flows > 1) /* might need interleave buffer */
+  if (max_planes > 1) /* might need interleave buffer */
     chain->il_buf = lsx_malloc(sox_globals.bufsiz * sizeof(sox_sample_t));
   else
     chain->il_buf = NULL;
@@ -430,9 +520,9 @@ int sox_flow_effects(sox_effects_chain_t * chain, int (* callback)(sox_bool all_
      buffers, deinterleave it (if necessary).  */
   for (e = 0; e + 1 < chain->length; e++) {
     sox_effect_t *effp = chain->effects[e];
-    if (effp->oend > effp->obeg && chain->effects[e+1]->flows > 1) {
+    if (effp->oend > effp->obeg && in_planes(chain, e + 1) > 1) {
       sox_sample_t *sw = chain->il_buf; chain->il_buf = effp->obuf; effp->obuf = sw;
-      deinterleave(chain->effects[e+1]->flows, effp->oend - effp->obeg,
+      deinterleave(in_planes(chain, e + 1), effp->oend - effp->obeg,
           chain->il_buf, effp->obuf, sox_globals.bufsiz, effp->obeg);
     }
   }
@@ -473,9 +563,9 @@ int sox_flow_effects(sox_effects_chain_t * chain, int (* callback)(sox_bool all_
      be reused, and at that time possibly followed by an MCHAN effect. */
   for (e = 0; e + 1 < chain->length; e++) {
     sox_effect_t *effp = chain->effects[e];
-    if (effp->oend > effp->obeg && chain->effects[e+1]->flows > 1) {
+    if (effp->oend > effp->obeg && in_planes(chain, e + 1) > 1) {
       sox_sample_t *sw = chain->il_buf; chain->il_buf = effp->obuf; effp->obuf = sw;
-      interleave(chain->effects[e+1]->flows, effp->oend - effp->obeg,
+      interleave(in_planes(chain, e + 1), effp->oend - effp->obeg,
           chain->il_buf, sox_globals.bufsiz, effp->obeg, effp->obuf);
     }
   }
@@ -484,6 +574,457 @@ int sox_flow_effects(sox_effects_chain_t * chain, int (* callback)(sox_bool all_
   return flow_status;
 }
 
+#ifdef HAVE_OPENMP_3_1
+/* Pipelined flow: the chain is split into groups of adjacent effects and
+ * each group is run by flow_effects_serial on a thread of its own, so the
+ * flow/drain contract seen by the effects is unchanged.  Adjacent groups are
+ * joined by a bounded single-producer/single-consumer queue of sample
+ * blocks, filled by a `pipe-out' pseudo-effect at the end of one group and
+ * emptied by a `pipe-in' pseudo-effect at the start of the next.  The queue
+ * indices are only ever written by one side, so no locks are needed.
+ */
+#define PIPE_SLOTS 4
+#define IO_PIPE_SLOTS 16 /* Deeper, to ride out stalls in file I/O */
+
+typedef struct {
+  sox_sample_t * data;  /* slots blocks of bufsiz samples */
+  size_t len[IO_PIPE_SLOTS];
+  size_t slots, bufsiz;
+  size_t head, tail;    /* Blocks written (by producer), read (by consumer) */
+  size_t pos;           /* Consumer: samples already taken from block @ tail */
+  size_t eof;           /* Set by the producer when it will write no more */
+  size_t abandoned;     /* Set by the consumer when it will read no more */
+} pipe_t;
+
+static size_t pipe_get(size_t * x)
+{
+  size_t result;
+  #pragma omp flush
+  #pragma omp atomic read
+  result = *x;
+  #pragma omp flush
+  return result;
+}
+
+static void pipe_set(size_t * x, size_t value)
+{
+  #pragma omp flush
+  #pragma omp atomic write
+  *x = value;
+  #pragma omp flush
+}
+
+static void pipe_wait(unsigned * spins)
+{
+  if (++*spins > 64) {
+#ifdef HAVE_SCHED_YIELD
+    sched_yield();
+#endif
+  }
+}
+
+static int pipe_out_flow(sox_effect_t * effp, const sox_sample_t * ibuf,
+    sox_sample_t * obuf UNUSED, size_t * isamp, size_t * osamp)
+{
+  pipe_t * p = *(pipe_t * *)effp->priv;
+  size_t head = pipe_get(&p->head);
+  unsigned spins = 0;
+
+  *osamp = 0;
+  if (!*isamp)
+    return SOX_SUCCESS;
+  while (head - pipe_get(&p->tail) == p->slots) { /* Full */
+    if (pipe_get(&p->abandoned)) {
+      *isamp = 0;
+      return SOX_EOF;
+    }
+    pipe_wait(&spins);
+  }
+  *isamp = min(*isamp, p->bufsiz);
+  memcpy(p->data + head % p->slots * p->bufsiz, ibuf, *isamp * sizeof(*ibuf));
+  p->len[head % p->slots] = *isamp;
+  pipe_set(&p->head, head + 1);
+  return SOX_SUCCESS;
+}
+
+static int pipe_in_drain(sox_effect_t * effp, sox_sample_t * obuf, size_t * osamp)
+{
+  pipe_t * p = *(pipe_t * *)effp->priv;
+  size_t tail = pipe_get(&p->tail);
+  unsigned spins = 0;
+
+  while (pipe_get(&p->head) == tail) { /* Empty */
+    if (pipe_get(&p->eof) && pipe_get(&p->head) == tail) {
+      *osamp = 0;
+      return SOX_EOF;
+    }
+    pipe_wait(&spins);
+  }
+  *osamp -= *osamp % effp->out_signal.channels;
+  *osamp = min(*osamp, p->len[tail % p->slots] - p->pos);
+  memcpy(obuf, p->data + tail % p->slots * p->bufsiz + p->pos,
+      *osamp * sizeof(*obuf));
+  if ((p->pos += *osamp) == p->len[tail % p->slots]) {
+    p->pos = 0;
+    pipe_set(&p->tail, tail + 1);
+  }
+  return SOX_SUCCESS;
+}
+
+static sox_effect_handler_t const pipe_in_handler = {
+  "pipe-in", NULL, SOX_EFF_MCHAN | SOX_EFF_INTERNAL,
+  NULL, NULL, NULL, pipe_in_drain, NULL, NULL, sizeof(pipe_t *)
+};
+
+static sox_effect_handler_t const pipe_out_handler = {
+  "pipe-out", NULL, SOX_EFF_MCHAN | SOX_EFF_INTERNAL,
+  NULL, NULL, pipe_out_flow, NULL, NULL, NULL, sizeof(pipe_t *)
+};
+
+static sox_effect_t * create_pipe_effect(sox_effects_chain_t * chain,
+    sox_effect_handler_t const * eh, pipe_t * p, sox_signalinfo_t const * signal)
+{
+  sox_effect_t * effp = sox_create_effect(eh);
+  *(pipe_t * *)effp->priv = p;
+  effp->global_info = &chain->global_info;
+  effp->in_signal = effp->out_signal = *signal;
+  effp->in_encoding = chain->in_enc;
+  effp->out_encoding = chain->out_enc;
+  effp->flows = 1;
+  return effp;
+}
+
+/* Group g comprises chain effects bounds[g] to bounds[g + 1] - 1 */
+static int flow_effects_pipelined(sox_effects_chain_t * chain, size_t groups,
+    size_t const * bounds,
+    int (* callback)(sox_bool all_done, void * client_data), void * client_data)
+{
+  sox_effects_chain_t * group = lsx_calloc(groups, sizeof(*group));
+  pipe_t * pipes = lsx_calloc(groups - 1, sizeof(*pipes));
+  size_t g, e, threads_run = 0;
+  int flow_status = SOX_SUCCESS, levels = omp_get_max_active_levels();
+
+  if (sox_globals.use_threads && levels < 2)
+    omp_set_max_active_levels(2); /* So groups can thread their channels */
+  for (g = 0; g < groups; ++g) {
+    size_t begin = bounds[g], end = bounds[g + 1];
+    sox_effects_chain_t * c = &group[g];
+
+    *c = *chain;
+    c->length = 0;
+    c->table_size = end - begin + 2;
+    c->effects = lsx_calloc(c->table_size, sizeof(*c->effects));
+    c->il_buf = NULL;
+    if (g) {
+      c->effects[c->length] = create_pipe_effect(chain, &pipe_in_handler,
+          &pipes[g - 1], &chain->effects[begin - 1]->out_signal);
+      if (float_link(chain, begin - 1)) /* Queue passes floats through */
+        c->effects[c->length]->handler.flags |= SOX_EFF_FLOAT;
+      ++c->length;
+    }
+    for (e = begin; e < end; ++e)
+      c->effects[c->length++] = chain->effects[e];
+    if (g + 1 < groups) {
+      pipes[g].slots = end == 1 || end + 1 == chain->length?
+          IO_PIPE_SLOTS : PIPE_SLOTS;
+      pipes[g].bufsiz = sox_globals.bufsiz;
+      pipes[g].data = lsx_calloc(pipes[g].slots * pipes[g].bufsiz, sizeof(*pipes[g].data));
+      c->effects[c->length] = create_pipe_effect(chain, &pipe_out_handler,
+          &pipes[g], &chain->effects[end - 1]->out_signal);
+      if (float_link(chain, end - 1))
+        c->effects[c->length]->handler.flags |= SOX_EFF_FLOAT;
+      ++c->length;
+    }
+  }
+
+  #pragma omp parallel num_threads(groups) default(none) \
+      shared(group,pipes,groups,callback,client_data,flow_status,threads_run)
+  {
+    /* Every group must have its own thread or the queues could deadlock */
+    if ((size_t)omp_get_num_threads() == groups) {
+      size_t t = omp_get_thread_num();
+      int status = flow_effects_serial(&group[t],
+          t + 1 == groups? callback : NULL, client_data);
+
+      if (t)
+        pipe_set(&pipes[t - 1].abandoned, 1);
+      if (t + 1 < groups)
+        pipe_set(&pipes[t].eof, 1);
+      if (status != SOX_SUCCESS) {
+        #pragma omp atomic write
+        flow_status = SOX_EOF;
+      }
+      #pragma omp atomic write
+      threads_run = groups;
+    }
+  }
+  omp_set_max_active_levels(levels);
+
+  for (g = 0; g < groups; ++g) {
+    if (g)
+      sox_delete_effect(group[g].effects[0]);
+    if (g + 1 < groups) {
+      sox_delete_effect(group[g].effects[group[g].length - 1]);
+      free(pipes[g].data);
+    }
+    free(group[g].effects);
+  }
+  free(pipes);
+  free(group);
+
+  if (threads_run != groups) {
+    lsx_debug_more("couldn't start %" PRIuPTR " threads; not pipelining", groups);
+    return flow_effects_serial(chain, callback, client_data);
+  }
+  return flow_status;
+}
+#endif
+
+/* Merges each run of adjacent biquad filter effects into one effect that
+ * runs them as a cascade (see lsx_biquad_absorb), saving a pass over the
+ * audio, and a trip through flow_effect(), for each effect merged */
+static void cascade_biquads(sox_effects_chain_t * chain)
+{
+  size_t n = 1, k;
+
+  while (n + 2 < chain->length) {
+    sox_effect_t * effp = chain->effects[n];
+    if (lsx_biquad_absorb(effp, chain->effects[n + 1], chain->float_samples)) {
+      lsx_debug("cascading %s", chain->effects[n + 1]->handler.name);
+      sox_delete_effect(chain->effects[n + 1]);
+      for (k = n + 1; k + 1 < chain->length; ++k)
+        chain->effects[k] = chain->effects[k + 1];
+      chain->effects[--chain->length] = NULL;
+    }
+    else ++n;
+  }
+}
+
+/* Fusion: each run of two or more adjacent SOX_EFF_FUSE effects is replaced
+ * by one effect whose flow takes its input a block of FUSE_SAMPLES at a time
+ * through each member in turn, so the run costs one pass over the chain's
+ * buffers, and one trip through flow_effect(), rather than one per member;
+ * the block passes between members in cache.  Members keep their own clip
+ * counts, reported by name and in order as if they had not been fused. */
+#define FUSE_SAMPLES 2048
+
+typedef struct {
+  size_t         num_members;
+  sox_effect_t   * * members;
+  size_t         block;           /* In frames */
+  sox_sample_t   * buf[2];        /* Between members */
+} fused_t;
+
+static void report_clips(sox_effect_t * effp, uint64_t clips)
+{
+  lsx_warn("%s clipped %" PRIu64 " samples; decrease volume?",
+      effp->handler.name, clips);
+}
+
+static int fused_block(fused_t * p, const sox_sample_t * ibuf,
+    sox_sample_t * obuf, size_t len)
+{
+  size_t k;
+
+  for (k = 0; k < p->num_members; ++k) {
+    sox_effect_t * effp = p->members[k];
+    size_t isamp = len * effp->in_signal.channels;
+    size_t osamp = len * effp->out_signal.channels;
+    const sox_sample_t * in = k? p->buf[(k - 1) & 1] : ibuf;
+    sox_sample_t * out = k + 1 < p->num_members? p->buf[k & 1] : obuf;
+
+    if (effp->handler.flow(effp, in, out, &isamp, &osamp) != SOX_SUCCESS)
+      return SOX_EOF;
+    if (isamp != len * effp->in_signal.channels ||
+        osamp != len * effp->out_signal.channels) {
+      lsx_fail("flowed asymmetrically!");
+      return SOX_EOF;
+    }
+  }
+  return SOX_SUCCESS;
+}
+
+static int fused_flow(sox_effect_t * effp, const sox_sample_t * ibuf,
+    sox_sample_t * obuf, size_t * isamp, size_t * osamp)
+{
+  fused_t * p = (fused_t *)effp->priv;
+  size_t ichans = effp->in_signal.channels, ochans = effp->out_signal.channels;
+  size_t len = min(*isamp / ichans, *osamp / ochans), done, n, k;
+  int result = SOX_SUCCESS;
+
+  p->members[0]->in_float = effp->in_float;
+  p->members[p->num_members - 1]->out_float = effp->out_float;
+  for (done = 0; done < len; done += n) {
+    n = min(len - done, p->block);
+    if (fused_block(p, ibuf + done * ichans, obuf + done * ochans, n) != SOX_SUCCESS) {
+      result = SOX_EOF;
+      break;
+    }
+  }
+  *isamp = done * ichans;
+  *osamp = done * ochans;
+  for (effp->clips = 0, k = 0; k < p->num_members; ++k)
+    effp->clips += p->members[k]->clips;
+  return result;
+}
+
+static int fused_stop(sox_effect_t * effp)
+{
+  fused_t * p = (fused_t *)effp->priv;
+  uint64_t clips;
+  size_t k;
+
+  for (k = 0; k < p->num_members; ++k)
+    if ((clips = sox_stop_effect(p->members[k])) != 0)
+      report_clips(p->members[k], clips);
+  effp->clips = 0;
+  return SOX_SUCCESS;
+}
+
+static int fused_kill(sox_effect_t * effp)
+{
+  fused_t * p = (fused_t *)effp->priv;
+  size_t k;
+
+  for (k = 0; k < p->num_members; ++k) {
+    sox_effect_t * member = p->members[k];
+    member->handler.kill(member);
+    free(member->priv);
+    free(member->obuf);
+    free(member);
+  }
+  free(p->members);
+  free(p->buf[0]);
+  free(p->buf[1]);
+  return SOX_SUCCESS;
+}
+
+static sox_effect_handler_t const fused_handler = {
+  "fused", NULL, SOX_EFF_MCHAN | SOX_EFF_INTERNAL,
+  NULL, NULL, fused_flow, NULL, fused_stop, fused_kill, sizeof(fused_t)
+};
+
+/* A planar effect (a biquad) is not fused if it could run planar, or, with
+ * -M, spread its channels across threads, which it does only for more than
+ * threads_min_samples at a time (so not for a fused block) */
+static sox_bool fusable(sox_effects_chain_t const * chain,
+    sox_effect_t const * effp)
+{
+  return (effp->handler.flags & SOX_EFF_FUSE) && effp->flows == 1 &&
+      !effp->obuf && /* Not yet flowed */
+      (!(effp->handler.flags & SOX_EFF_PLANAR) ||
+       (!chain->planar && !sox_globals.use_threads));
+}
+
+/* Replaces chain effects begin to end - 1 with one fused effect */
+static void fuse(sox_effects_chain_t * chain, size_t begin, size_t end)
+{
+  sox_effect_t * effp = sox_create_effect(&fused_handler);
+  fused_t * p = (fused_t *)effp->priv;
+  sox_effect_t * first = chain->effects[begin], * last = chain->effects[end - 1];
+  size_t k, channels = first->in_signal.channels;
+
+  p->num_members = end - begin;
+  p->members = lsx_malloc(p->num_members * sizeof(*p->members));
+  for (k = 0; k < p->num_members; ++k) {
+    sox_effect_t * member = p->members[k] = chain->effects[begin + k];
+    lsx_debug("fusing %s", member->handler.name);
+    channels = max(channels, member->out_signal.channels);
+    member->planar = sox_false;
+    if (k)
+      member->in_float = p->members[k - 1]->out_float =
+          chain->float_samples &&
+          (p->members[k - 1]->handler.flags & SOX_EFF_FLOAT) &&
+          (member->handler.flags & SOX_EFF_FLOAT);
+  }
+  p->block = max(FUSE_SAMPLES / channels, 1);
+  p->buf[0] = lsx_malloc(p->block * channels * sizeof(*p->buf[0]));
+  p->buf[1] = lsx_malloc(p->block * channels * sizeof(*p->buf[1]));
+
+  effp->global_info = first->global_info;
+  effp->in_signal = first->in_signal;
+  effp->out_signal = last->out_signal;
+  effp->in_encoding = first->in_encoding;
+  effp->out_encoding = last->out_encoding;
+  effp->flows = 1;
+  if ((first->handler.flags & last->handler.flags) & SOX_EFF_FLOAT)
+    effp->handler.flags |= SOX_EFF_FLOAT;
+
+  chain->effects[begin] = effp;
+  for (k = begin + 1; k + p->num_members - 1 < chain->length; ++k)
+    chain->effects[k] = chain->effects[k + p->num_members - 1];
+  for (k = 1; k < p->num_members; ++k)
+    chain->effects[--chain->length] = NULL;
+}
+
+/* The fused effect can exchange floats with its neighbours only if both its
+ * first and last members can, so a run is shortened at an end where
+ * fusing would otherwise lose a float link (see float_link) */
+static sox_bool float_flag(sox_effects_chain_t const * chain, size_t n)
+{
+  return chain->float_samples &&
+      (chain->effects[n]->handler.flags & SOX_EFF_FLOAT);
+}
+
+static void fuse_effects(sox_effects_chain_t * chain)
+{
+  size_t n = 1, end;
+
+  while (n + 2 < chain->length) {
+    for (end = n; end + 1 < chain->length && fusable(chain, chain->effects[end]); ++end);
+    while (end - n > 1 &&
+        float_flag(chain, n) != float_flag(chain, end - 1)) {
+      if (float_flag(chain, n) && float_flag(chain, n - 1))
+        ++n;
+      else if (float_flag(chain, end - 1) && float_flag(chain, end))
+        --end;
+      else break;
+    }
+    if (end - n > 1)
+      fuse(chain, n++, end);
+    else n = max(end, n + 1);
+  }
+}
+
+/* Opt-in (see sox.h), as it changes the chain's effects */
+void sox_optimize_effects_chain(sox_effects_chain_t * chain)
+{
+  cascade_biquads(chain);
+  fuse_effects(chain);
+}
+
+/* Flow data through the effects chain until an effect or callback gives EOF */
+int sox_flow_effects(sox_effects_chain_t * chain, int (* callback)(sox_bool all_done, void * client_data), void * client_data)
+{
+#ifdef HAVE_OPENMP_3_1
+  size_t length, groups, g, * bounds;
+  int result;
+
+  length = chain->length, groups = min(sox_globals.pipeline_stages, length);
+  if (sox_globals.io_threads && length > 1) {
+    /* The input & output effects each get a group (so a thread) of their
+     * own; any effects between are grouped as for pipeline_stages */
+    size_t middle = length - 2;
+    groups = min(max(groups, 1), middle) + 2;
+    bounds = lsx_malloc((groups + 1) * sizeof(*bounds));
+    bounds[0] = 0, bounds[groups] = length;
+    for (g = 1; g < groups; ++g)
+      bounds[g] = 1 + (g - 1) * middle / max(groups - 2, 1);
+  }
+  else if (groups > 1) {
+    bounds = lsx_malloc((groups + 1) * sizeof(*bounds));
+    for (g = 0; g <= groups; ++g)
+      bounds[g] = g * length / groups;
+  }
+  else return flow_effects_serial(chain, callback, client_data);
+  result = flow_effects_pipelined(chain, groups, bounds, callback, client_data);
+  free(bounds);
+  return result;
+#else
+  return flow_effects_serial(chain, callback, client_data);
+#endif
+}
+
 sox_uint64_t sox_effects_clips(sox_effects_chain_t * chain)
 {
   size_t i, f;
@@ -542,8 +1083,7 @@ void sox_delete_effect(sox_effect_t *effp)
   size_t f;
 
   if ((clips = sox_stop_effect(effp)) != 0)
-    lsx_warn("%s clipped %" PRIu64 " samples; decrease volume?",
-        effp->handler.name, clips);
+    report_clips(effp, clips);
   if (effp->obeg != effp->oend)
     lsx_debug("output buffer still held %" PRIuPTR " samples; dropped.",
         (effp->oend - effp->obeg)/effp->out_signal.channels);
@@ -612,6 +1152,81 @@ sox_effect_handler_t const * sox_find_effect(char const * name)
 
 /*----------------------------- Helper functions -----------------------------*/
 
+/* The channel (un)interleaving below is specialised for the most common
+ * channel counts, so that the inner loop has a fixed stride and can be
+ * unrolled; where SSE2 is available, 2, 4 and 8 channels are shuffled four
+ * wide samples at a time. */
+
+#ifdef __SSE2__
+static void transpose4(__m128i * a, __m128i * b, __m128i * c, __m128i * d)
+{
+  __m128i t0 = _mm_unpacklo_epi32(*a, *b), t1 = _mm_unpacklo_epi32(*c, *d);
+  __m128i t2 = _mm_unpackhi_epi32(*a, *b), t3 = _mm_unpackhi_epi32(*c, *d);
+  *a = _mm_unpacklo_epi64(t0, t1), *b = _mm_unpackhi_epi64(t0, t1);
+  *c = _mm_unpacklo_epi64(t2, t3), *d = _mm_unpackhi_epi64(t2, t3);
+}
+
+/* Channels are taken 4 at a time; returns the number of wide samples done */
+static size_t interleave_sse2(size_t flows, size_t wide_samples,
+    sox_sample_t const * from, size_t flow_offs, sox_sample_t * to)
+{
+  size_t i, f;
+  for (i = 0; i + 4 <= wide_samples; i += 4, to += 4 * flows) {
+    if (flows == 2) {
+      __m128i l = _mm_loadu_si128((__m128i const *)(from + i));
+      __m128i r = _mm_loadu_si128((__m128i const *)(from + flow_offs + i));
+      _mm_storeu_si128((__m128i *)to, _mm_unpacklo_epi32(l, r));
+      _mm_storeu_si128((__m128i *)to + 1, _mm_unpackhi_epi32(l, r));
+    }
+    else for (f = 0; f < flows; f += 4) {
+      sox_sample_t const * p = from + f * flow_offs + i;
+      __m128i a = _mm_loadu_si128((__m128i const *)p);
+      __m128i b = _mm_loadu_si128((__m128i const *)(p + flow_offs));
+      __m128i c = _mm_loadu_si128((__m128i const *)(p + 2 * flow_offs));
+      __m128i d = _mm_loadu_si128((__m128i const *)(p + 3 * flow_offs));
+      transpose4(&a, &b, &c, &d);
+      _mm_storeu_si128((__m128i *)(to + f), a);
+      _mm_storeu_si128((__m128i *)(to + flows + f), b);
+      _mm_storeu_si128((__m128i *)(to + 2 * flows + f), c);
+      _mm_storeu_si128((__m128i *)(to + 3 * flows + f), d);
+    }
+  }
+  return i;
+}
+
+static size_t deinterleave_sse2(size_t flows, size_t wide_samples,
+    sox_sample_t const * from, sox_sample_t * to, size_t flow_offs)
+{
+  size_t i, f;
+  for (i = 0; i + 4 <= wide_samples; i += 4, from += 4 * flows) {
+    if (flows == 2) {
+      __m128i a = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)from), 0xd8);
+      __m128i b = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)from + 1), 0xd8);
+      _mm_storeu_si128((__m128i *)(to + i), _mm_unpacklo_epi64(a, b));
+      _mm_storeu_si128((__m128i *)(to + flow_offs + i), _mm_unpackhi_epi64(a, b));
+    }
+    else for (f = 0; f < flows; f += 4) {
+      sox_sample_t * p = to + f * flow_offs + i;
+      __m128i a = _mm_loadu_si128((__m128i const *)(from + f));
+      __m128i b = _mm_loadu_si128((__m128i const *)(from + flows + f));
+      __m128i c = _mm_loadu_si128((__m128i const *)(from + 2 * flows + f));
+      __m128i d = _mm_loadu_si128((__m128i const *)(from + 3 * flows + f));
+      transpose4(&a, &b, &c, &d);
+      _mm_storeu_si128((__m128i *)p, a);
+      _mm_storeu_si128((__m128i *)(p + flow_offs), b);
+      _mm_storeu_si128((__m128i *)(p + 2 * flow_offs), c);
+      _mm_storeu_si128((__m128i *)(p + 3 * flow_offs), d);
+    }
+  }
+  return i;
+}
+#endif
+
+#define INTERLEAVE(N) for (; i < wide_samples; i++, to += N) \
+    for (f = 0; f < N; f++) to[f] = from[f * flow_offs + i]
+#define DEINTERLEAVE(N) for (; i < wide_samples; i++, from += N) \
+    for (f = 0; f < N; f++) to[f * flow_offs + i] = from[f]
+
 /* interleave() parameters:
  *   flows: number of samples per wide sample
  *   length: number of samples to copy
@@ -625,18 +1240,23 @@ sox_effect_handler_t const * sox_find_effect(char const * name)
 static void interleave(size_t flows, size_t length, sox_sample_t *from,
     size_t bufsiz, size_t offset, sox_sample_t *to)
 {
-  size_t i;
+  size_t i = 0, f;
   const size_t wide_samples = length/flows;
   const size_t flow_offs = bufsiz/flows;
   from += offset/flows;
-  for (i = 0; i < wide_samples; i++) {
-    sox_sample_t *inner_from = from + i;
-    sox_sample_t *inner_to = to + i * flows;
-    size_t f;
-    for (f = 0; f < flows; f++) {
-      *inner_to++ = *inner_from;
-      inner_from += flow_offs;
-    }
+#ifdef __SSE2__
+  if (flows == 2 || flows == 4 || flows == 8) {
+    i = interleave_sse2(flows, wide_samples, from, flow_offs, to);
+    to += i * flows;
+  }
+#endif
+  switch (flows) {
+    case 1: memcpy(to, from, length * sizeof(*to)); break;
+    case 2: INTERLEAVE(2); break;
+    case 4: INTERLEAVE(4); break;
+    case 6: INTERLEAVE(6); break;
+    case 8: INTERLEAVE(8); break;
+    default: INTERLEAVE(flows); break;
   }
 }
 
@@ -653,17 +1273,22 @@ static void interleave(size_t flows, size_t length, sox_sample_t *from,
 static void deinterleave(size_t flows, size_t length, sox_sample_t *from,
     sox_sample_t *to, size_t bufsiz, size_t offset)
 {
+  size_t i = 0, f;
   const size_t wide_samples = length/flows;
   const size_t flow_offs = bufsiz/flows;
-  size_t f;
   to += offset/flows;
-  for (f = 0; f < flows; f++) {
-    sox_sample_t *inner_to = to + f*flow_offs;
-    sox_sample_t *inner_from = from + f;
-    size_t i = wide_samples;
-    while (i--) {
-      *inner_to++ = *inner_from;
-      inner_from += flows;
-    }
+#ifdef __SSE2__
+  if (flows == 2 || flows == 4 || flows == 8) {
+    i = deinterleave_sse2(flows, wide_samples, from, to, flow_offs);
+    from += i * flows;
+  }
+#endif
+  switch (flows) {
+    case 1: memcpy(to, from, length * sizeof(*to)); break;
+    case 2: DEINTERLEAVE(2); break;
+    case 4: DEINTERLEAVE(4); break;
+    case 6: DEINTERLEAVE(6); break;
+    case 8: DEINTERLEAVE(8); break;
+    default: DEINTERLEAVE(flows); break;
   }
 }
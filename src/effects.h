@@ -26,6 +26,7 @@
   EFFECT(channels)
   EFFECT(compand)
   EFFECT(contrast)
+  EFFECT(convolve)
   EFFECT(dcshift)
   EFFECT(deemph)
   EFFECT(delay)
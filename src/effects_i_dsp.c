@@ -26,67 +26,6 @@
 #include <assert.h>
 #include <string.h>
 
-/* Concurrent Control with "Readers" and "Writers", P.J. Courtois et al, 1971:*/
-
-#if defined HAVE_OPENMP
-
-typedef struct {
-  int readcount, writecount; /* initial value = 0 */
-  omp_lock_t mutex_1, mutex_2, mutex_3, w, r; /* initial value = 1 */
-} ccrw2_t; /* Problem #2: `writers-preference' */
-
-#define ccrw2_become_reader(p) do {\
-  omp_set_lock(&p.mutex_3);\
-    omp_set_lock(&p.r);\
-      omp_set_lock(&p.mutex_1);\
-        if (++p.readcount == 1) omp_set_lock(&p.w);\
-      omp_unset_lock(&p.mutex_1);\
-    omp_unset_lock(&p.r);\
-  omp_unset_lock(&p.mutex_3);\
-} while (0)
-#define ccrw2_cease_reading(p) do {\
-  omp_set_lock(&p.mutex_1);\
-    if (!--p.readcount) omp_unset_lock(&p.w);\
-  omp_unset_lock(&p.mutex_1);\
-} while (0)
-#define ccrw2_become_writer(p) do {\
-  omp_set_lock(&p.mutex_2);\
-    if (++p.writecount == 1) omp_set_lock(&p.r);\
-  omp_unset_lock(&p.mutex_2);\
-  omp_set_lock(&p.w);\
-} while (0)
-#define ccrw2_cease_writing(p) do {\
-  omp_unset_lock(&p.w);\
-  omp_set_lock(&p.mutex_2);\
-    if (!--p.writecount) omp_unset_lock(&p.r);\
-  omp_unset_lock(&p.mutex_2);\
-} while (0)
-#define ccrw2_init(p) do {\
-  omp_init_lock(&p.mutex_1);\
-  omp_init_lock(&p.mutex_2);\
-  omp_init_lock(&p.mutex_3);\
-  omp_init_lock(&p.w);\
-  omp_init_lock(&p.r);\
-} while (0)
-#define ccrw2_clear(p) do {\
-  omp_destroy_lock(&p.r);\
-  omp_destroy_lock(&p.w);\
-  omp_destroy_lock(&p.mutex_3);\
-  omp_destroy_lock(&p.mutex_2);\
-  omp_destroy_lock(&p.mutex_1);\
-} while (0)
-
-#else
-
-#define ccrw2_become_reader(x) (void)0
-#define ccrw2_cease_reading(x) (void)0
-#define ccrw2_become_writer(x) (void)0
-#define ccrw2_cease_writing(x) (void)0
-#define ccrw2_init(x) (void)0
-#define ccrw2_clear(x) (void)0
-
-#endif /* HAVE_OPENMP */
-
 /* Numerical Recipes cubic spline: */
 
 void lsx_prepare_spline3(double const * x, double const * y, int n,
@@ -156,75 +95,169 @@ int lsx_set_dft_length(int num_taps) /* Set to 4 x nearest power of 2 */
 }
 
 #include "fft4g.h"
-static int * lsx_fft_br;
-static double * lsx_fft_sc;
-static int fft_len = -1;
-#if defined HAVE_OPENMP
-static ccrw2_t fft_cache_ccrw;
+#include "fftsse2.h"
+
+/* lsx_safe_rdft & lsx_safe_cdft pass the transform to one of the following
+ * backends, selected by name via sox_globals.fft_backend (default: the
+ * first).  All take the same lengths and have fft4g's layout, signs and
+ * scaling; fft4g is the reference implementation. */
+
+static void * fft4g_plan(int len);
+static void fft4g_free(void * plan);
+static void fft4g_rdft(int len, int type, double * d, void const * plan);
+static void fft4g_cdft(int len, int type, double * d, void const * plan);
+#ifdef __SSE2__
+static void * sse2_plan(int len) {return lsx_fftsse2_plan(len);}
+static void sse2_free(void * plan) {lsx_fftsse2_free(plan);}
+static void sse2_rdft(int len, int type, double * d, void const * plan)
+  {lsx_fftsse2_rdft(len, type, d, plan);}
+static void sse2_cdft(int len, int type, double * d, void const * plan)
+  {lsx_fftsse2_cdft(len, type, d, plan);}
 #endif
 
+static struct {
+  char const * name;
+  void * (* plan)(int len);
+  void (* free)(void * plan);
+  void (* rdft)(int len, int type, double * d, void const * plan);
+  void (* cdft)(int len, int type, double * d, void const * plan);
+} const fft_backends[] = {
+#ifdef __SSE2__
+  {"sse2", sse2_plan, sse2_free, sse2_rdft, sse2_cdft},
+#endif
+  {"fft4g", fft4g_plan, fft4g_free, fft4g_rdft, fft4g_cdft},
+};
+
+/* Each backend & FFT length has its own tables (a `plan'), created on first
+ * use and never modified after it has been published, so that concurrent
+ * transforms need no locking; only the creation of a plan is serialised. */
+
+#define FFT_PLANS 19 /* 1 << (FFT_PLANS - 1) == FFT4G_MAX_SIZE */
+static void * fft_plans[array_length(fft_backends)][FFT_PLANS];
+static sox_bool fft_plans_ready = sox_false;
+
 void init_fft_cache(void)
 {
-  assert(lsx_fft_br == NULL);
-  assert(lsx_fft_sc == NULL);
-  assert(fft_len == -1);
-  ccrw2_init(fft_cache_ccrw);
-  fft_len = 0;
+  assert(!fft_plans_ready);
+  fft_plans_ready = sox_true;
 }
 
 void clear_fft_cache(void)
 {
-  assert(fft_len >= 0);
-  ccrw2_clear(fft_cache_ccrw);
-  free(lsx_fft_br);
-  free(lsx_fft_sc);
-  lsx_fft_sc = NULL;
-  lsx_fft_br = NULL;
-  fft_len = -1;
-}
-
-static sox_bool update_fft_cache(int len)
-{
-  assert(lsx_is_power_of_2(len));
-  assert(fft_len >= 0);
-  ccrw2_become_reader(fft_cache_ccrw);
-  if (len > fft_len) {
-    ccrw2_cease_reading(fft_cache_ccrw);
-    ccrw2_become_writer(fft_cache_ccrw);
-    if (len > fft_len) {
-      int old_n = fft_len;
-      fft_len = len;
-      lsx_fft_br = lsx_realloc(lsx_fft_br, dft_br_len(fft_len) * sizeof(*lsx_fft_br));
-      lsx_fft_sc = lsx_realloc(lsx_fft_sc, dft_sc_len(fft_len) * sizeof(*lsx_fft_sc));
-      if (!old_n)
-        lsx_fft_br[0] = 0;
-      return sox_true;
+  size_t b;
+  int i;
+  assert(fft_plans_ready);
+  for (b = 0; b < array_length(fft_backends); ++b)
+    for (i = 0; i < FFT_PLANS; ++i) {
+      fft_backends[b].free(fft_plans[b][i]);
+      fft_plans[b][i] = NULL;
     }
-    ccrw2_cease_writing(fft_cache_ccrw);
-    ccrw2_become_reader(fft_cache_ccrw);
-  }
-  return sox_false;
+  fft_plans_ready = sox_false;
 }
 
-static void done_with_fft_cache(sox_bool is_writer)
+char const * sox_fft_backend_name(size_t n)
 {
-  if (is_writer)
-    ccrw2_cease_writing(fft_cache_ccrw);
-  else ccrw2_cease_reading(fft_cache_ccrw);
+  return n < array_length(fft_backends)? fft_backends[n].name : NULL;
 }
 
+static size_t fft_backend(void)
+{
+  char const * name = sox_globals.fft_backend;
+  size_t b;
+
+  if (name)
+    for (b = 0; b < array_length(fft_backends); ++b)
+      if (!strcmp(name, fft_backends[b].name))
+        return b;
+  return 0;
+}
+
+static void const * fft_plan(size_t b, int len)
+{
+  void * plan;
+  int i;
+
+  assert(lsx_is_power_of_2(len) && len <= FFT4G_MAX_SIZE);
+  assert(fft_plans_ready);
+  for (i = 0; (1 << i) < len; ++i);
+#ifdef HAVE_OPENMP_3_1
+  #pragma omp atomic read
+  plan = fft_plans[b][i];
+  #pragma omp flush
+#else
+  plan = NULL;
+#endif
+  if (!plan) {
+    #pragma omp critical(fft_plans)
+    {
+      if (!(plan = fft_plans[b][i])) {
+        plan = fft_backends[b].plan(len);
+#ifdef HAVE_OPENMP_3_1
+        #pragma omp flush
+        #pragma omp atomic write
+#endif
+        fft_plans[b][i] = plan;
+      }
+    }
+  }
+  return plan;
+}
+
+/* As fft4g does, a too-long transform is not done */
 void lsx_safe_rdft(int len, int type, double * d)
 {
-  sox_bool is_writer = update_fft_cache(len);
-  lsx_rdft(len, type, d, lsx_fft_br, lsx_fft_sc);
-  done_with_fft_cache(is_writer);
+  size_t b = fft_backend();
+  if (len <= FFT4G_MAX_SIZE)
+    fft_backends[b].rdft(len, type, d, fft_plan(b, len));
 }
 
 void lsx_safe_cdft(int len, int type, double * d)
 {
-  sox_bool is_writer = update_fft_cache(len);
-  lsx_cdft(len, type, d, lsx_fft_br, lsx_fft_sc);
-  done_with_fft_cache(is_writer);
+  size_t b = fft_backend();
+  if (len <= FFT4G_MAX_SIZE)
+    fft_backends[b].cdft(len, type, d, fft_plan(b, len));
+}
+
+/* fft4g backend: */
+
+typedef struct {
+  int        * br;
+  double     * sc;
+} fft4g_plan_t;
+
+static void * fft4g_plan(int len)
+{
+  fft4g_plan_t * plan = lsx_malloc(sizeof(*plan));
+  double * d = lsx_calloc(len, sizeof(*d));
+
+  plan->br = lsx_malloc(dft_br_len(len) * sizeof(*plan->br));
+  plan->sc = lsx_malloc(dft_sc_len(len) * sizeof(*plan->sc));
+  plan->br[0] = 0;
+  lsx_rdft(len, 1, d, plan->br, plan->sc); /* Fills the tables for r & c dft */
+  free(d);
+  return plan;
+}
+
+static void fft4g_free(void * plan)
+{
+  fft4g_plan_t * p = plan;
+  if (p) {
+    free(p->br);
+    free(p->sc);
+    free(p);
+  }
+}
+
+static void fft4g_rdft(int len, int type, double * d, void const * plan)
+{
+  fft4g_plan_t const * p = plan;
+  lsx_rdft(len, type, d, p->br, p->sc);
+}
+
+static void fft4g_cdft(int len, int type, double * d, void const * plan)
+{
+  fft4g_plan_t const * p = plan;
+  lsx_cdft(len, type, d, p->br, p->sc);
 }
 
 void lsx_power_spectrum(int n, double const * in, double * out)
@@ -621,6 +654,8 @@ void lsx_load_samples(double * const dest, sox_sample_t const * const src,
     dest[i] = src[i];
 }
 
+#define SAMPLE_SCALE (SOX_SAMPLE_MAX + 1.) /* Value of full scale in src/dest */
+
 #pragma STDC FENV_ACCESS OFF
 #undef _
 #else
@@ -642,4 +677,33 @@ void lsx_load_samples(double * const dest, sox_sample_t const * const src,
     dest[i] = SOX_SAMPLE_TO_FLOAT_64BIT(src[i],);
 }
 
+#define SAMPLE_SCALE 1.
+
 #endif
+
+/* As lsx_save_samples/lsx_load_samples, but for the output/input buffer of
+ * a SOX_EFF_FLOAT effect, which may be exchanging floats with its neighbour;
+ * floats are not clipped. */
+void lsx_effect_save_samples(sox_effect_t * effp, sox_sample_t * dest,
+    double const * src, size_t n)
+{
+  if (effp->out_float) {
+    float * d = (float *)dest;
+    size_t i;
+    for (i = 0; i < n; ++i)
+      d[i] = (float)(src[i] * (1 / SAMPLE_SCALE));
+  }
+  else lsx_save_samples(dest, src, n, &effp->clips);
+}
+
+void lsx_effect_load_samples(sox_effect_t const * effp, double * dest,
+    sox_sample_t const * src, size_t n)
+{
+  if (effp->in_float) {
+    float const * s = (float const *)src;
+    size_t i;
+    for (i = 0; i < n; ++i)
+      dest[i] = s[i] * SAMPLE_SCALE;
+  }
+  else lsx_load_samples(dest, src, n);
+}
@@ -0,0 +1,213 @@
+/* libSoX SSE2 FFT    Copyright (c) 2026 SoX contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Complex FFT: Stockham auto-sort, radix 4 (with a final radix 2 pass for
+ * odd powers of 2), one complex value per SSE2 vector; being auto-sorting,
+ * there is no bit-reversal pass, but a work buffer is needed.  The real FFT
+ * is a complex FFT of half the length, followed (or, for the inverse,
+ * preceded) by the usual split into the spectra of the even & odd samples.
+ * Signs, layout & scaling follow fft4g's cdft & rdft, i.e. `forward' uses
+ * exp(+2*pi*i*j*k/n), and rdft packs R[n/2] into d[1]. */
+
+#ifdef NDEBUG /* Enable assert always. */
+#undef NDEBUG /* Must undef above assert.h or other that might include it. */
+#endif
+
+#include "sox_i.h"
+
+#ifdef __SSE2__
+#include "fftsse2.h"
+#include <assert.h>
+#include <emmintrin.h>
+#include <string.h>
+
+struct lsx_fftsse2_plan {
+  int        n;           /* Number of complex points */
+  double     * w;         /* Twiddles for radix4; see there */
+  double     * rw;        /* exp(+2*pi*i*k/2n), k <= n/2 (for rdft) */
+};
+
+#define WORK_ON_STACK 2048 /* Complex points; larger transforms malloc */
+
+lsx_fftsse2_plan_t * lsx_fftsse2_plan(int len)
+{
+  lsx_fftsse2_plan_t * p = lsx_malloc(sizeof(*p));
+  int j, k, n = len >> 1, nw = max(n / 4, 1);
+
+  p->n = n;
+  p->w = lsx_malloc(12 * nw * sizeof(*p->w));
+  for (k = 0; k < nw; ++k) for (j = 1; j <= 3; ++j) {
+    double * w = p->w + 12 * k + 4 * (j - 1);
+    w[0] = w[1] = cos(2 * M_PI * j * k / n);
+    w[3] = -(w[2] = sin(2 * M_PI * j * k / n));
+  }
+  p->rw = lsx_malloc(2 * (n / 2 + 1) * sizeof(*p->rw));
+  for (k = 0; k <= n / 2; ++k) {
+    p->rw[2 * k] = cos(M_PI * k / n);
+    p->rw[2 * k + 1] = sin(M_PI * k / n);
+  }
+  return p;
+}
+
+void lsx_fftsse2_free(lsx_fftsse2_plan_t * p)
+{
+  if (p) {
+    free(p->w);
+    free(p->rw);
+    free(p);
+  }
+}
+
+#define ld(p)         _mm_loadu_pd(p)
+#define st(p, x)      _mm_storeu_pd(p, x)
+#define swap(x)       _mm_shuffle_pd(x, x, 1)
+#define cmul(x, r, i)  _mm_add_pd(_mm_mul_pd(x, r), _mm_mul_pd(swap(x), i))
+#define cmulc(x, r, i) _mm_sub_pd(_mm_mul_pd(x, r), _mm_mul_pd(swap(x), i))
+
+/* One radix-4 pass over sub-transforms of length l, with stride s = n / l.
+ * The twiddles exp(-2*pi*i*j*k/n) (j = 1, 2, 3) for this pass are those of
+ * the first pass (s = 1) at k = p * s; each is held as (re, re), (-im, im).
+ * For exp(-...), the twiddles are multiplied with CMUL = cmul, and the
+ * j-rotation, by xor-ing a swapped value with NEG = (-0, 0), is by i; for
+ * exp(+...), cmulc uses the conjugate twiddles and NEG = (0, -0) gives -i. */
+#define RADIX4(FN, CMUL, NEG) \
+static void FN(int l, int s, double const * x, double * y, double const * w) \
+{ \
+  int p, q, l4 = l >> 2, s2 = s << 1, l4s2 = l4 * s2; \
+  __m128d neg = NEG; \
+ \
+  for (p = 0; p < l4; ++p) { \
+    double const * a = x + p * s2, * t = w + 12 * p * s; \
+    double * b = y + 4 * p * s2; \
+    __m128d r1 = ld(t), i1 = ld(t + 2), r2 = ld(t + 4), i2 = ld(t + 6); \
+    __m128d r3 = ld(t + 8), i3 = ld(t + 10); \
+ \
+    for (q = 0; q < s2; q += 2) { \
+      __m128d a0 = ld(a + q), a1 = ld(a + q + l4s2); \
+      __m128d a2 = ld(a + q + 2 * l4s2), a3 = ld(a + q + 3 * l4s2); \
+      __m128d apc = _mm_add_pd(a0, a2), amc = _mm_sub_pd(a0, a2); \
+      __m128d bpd = _mm_add_pd(a1, a3), bmd = _mm_sub_pd(a1, a3); \
+      __m128d jbmd = _mm_xor_pd(swap(bmd), neg); \
+      st(b + q, _mm_add_pd(apc, bpd)); \
+      st(b + q + s2, CMUL(_mm_sub_pd(amc, jbmd), r1, i1)); \
+      st(b + q + 2 * s2, CMUL(_mm_sub_pd(apc, bpd), r2, i2)); \
+      st(b + q + 3 * s2, CMUL(_mm_add_pd(amc, jbmd), r3, i3)); \
+    } \
+  } \
+}
+
+RADIX4(radix4n, cmul,  _mm_set_pd(0., -0.))
+RADIX4(radix4p, cmulc, _mm_set_pd(-0., 0.))
+
+/* The final pass when log2(n) is odd */
+static void radix2(int s, double const * x, double * y)
+{
+  int q, s2 = s << 1;
+  for (q = 0; q < s2; q += 2) {
+    __m128d a = ld(x + q), b = ld(x + q + s2);
+    st(y + q, _mm_add_pd(a, b));
+    st(y + q + s2, _mm_sub_pd(a, b));
+  }
+}
+
+static void cfft(lsx_fftsse2_plan_t const * p, int sign, double * d)
+{
+  double stack_work[2 * WORK_ON_STACK];
+  double * work = p->n <= WORK_ON_STACK? stack_work :
+    lsx_malloc(2 * p->n * sizeof(*work));
+  double * x = d, * y = work, * t;
+  int l, s;
+
+  for (l = p->n, s = 1; l >= 4; l >>= 2, s <<= 2) {
+    if (sign >= 0)
+      radix4p(l, s, x, y, p->w);
+    else radix4n(l, s, x, y, p->w);
+    t = x, x = y, y = t;
+  }
+  if (l == 2)
+    radix2(s, x, y), t = x, x = y, y = t;
+  if (x != d)
+    memcpy(d, x, 2 * p->n * sizeof(*d));
+  if (work != stack_work)
+    free(work);
+}
+
+void lsx_fftsse2_cdft(int len, int type, double * d,
+    lsx_fftsse2_plan_t const * p)
+{
+  assert(len >> 1 == p->n);
+  cfft(p, type, d);
+}
+
+/* Forward: X[k] = E[k] + W^k O[k] (W = exp(+2*pi*i/len)), where
+ *   E[k] = (Z[k] + conj(Z[n-k])) / 2 and O[k] = (Z[k] - conj(Z[n-k])) / 2i
+ * and Z is the complex FFT of the samples taken as n = len/2 complex values.
+ * Inverse: Z[k] = E[k] + i O[k], where E[k] = (X[k] + conj(X[n-k])) / 2 and
+ * O[k] = (X[k] - conj(X[n-k])) conj(W^k) / 2; then a complex inverse FFT. */
+static void split(lsx_fftsse2_plan_t const * p, double * d, int type)
+{
+  int k, n = p->n;
+  __m128d half = _mm_set1_pd(.5);
+  __m128d cj = _mm_set_pd(-0., 0.);            /* xor: conjugate */
+  __m128d ni = _mm_set_pd(-0., 0.);            /* xor after swap: mul by -i */
+  __m128d pi = _mm_set_pd(0., -0.);            /* xor after swap: mul by i */
+
+  for (k = 1; k <= n >> 1; ++k) {
+    double * a = d + 2 * k, * b = d + 2 * (n - k);
+    __m128d zk = ld(a), zn = _mm_xor_pd(ld(b), cj);       /* zn = conj(Z[n-k]) */
+    __m128d w = ld(p->rw + 2 * k);
+    __m128d wr = _mm_unpacklo_pd(w, w), wi = _mm_unpackhi_pd(w, w);
+    __m128d e = _mm_mul_pd(_mm_add_pd(zk, zn), half);
+    __m128d o = _mm_mul_pd(_mm_sub_pd(zk, zn), half), e2, o2;
+
+    if (type >= 0) {
+      o = _mm_xor_pd(swap(o), ni);                 /* o /= i */
+      o = cmul(o, wr, _mm_xor_pd(wi, _mm_set_pd(0., -0.)));
+      /* X[k] = e + o; X[n-k] = conj(e - o) */
+      e2 = _mm_add_pd(e, o), o2 = _mm_xor_pd(_mm_sub_pd(e, o), cj);
+    }
+    else {
+      o = cmul(o, wr, _mm_xor_pd(wi, _mm_set_pd(-0., 0.)));  /* * conj(W^k) */
+      o = _mm_xor_pd(swap(o), pi);                 /* o *= i */
+      /* Z[k] = e + i o; Z[n-k] = conj(e - i o) */
+      e2 = _mm_add_pd(e, o), o2 = _mm_xor_pd(_mm_sub_pd(e, o), cj);
+    }
+    st(b, o2);
+    st(a, e2);
+  }
+}
+
+void lsx_fftsse2_rdft(int len, int type, double * d,
+    lsx_fftsse2_plan_t const * p)
+{
+  double x0 = d[0], x1 = d[1];
+
+  assert(len >> 1 == p->n);
+  if (type >= 0) {
+    cfft(p, 1, d);
+    x0 = d[0], x1 = d[1];
+    d[0] = x0 + x1, d[1] = x0 - x1;
+    split(p, d, type);
+  }
+  else {
+    split(p, d, type);
+    d[0] = .5 * (x0 + x1), d[1] = .5 * (x0 - x1);
+    cfft(p, -1, d);
+  }
+}
+
+#endif
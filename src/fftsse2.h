@@ -0,0 +1,29 @@
+/* libSoX SSE2 FFT    Copyright (c) 2026 SoX contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Drop-in alternatives to fft4g's lsx_rdft & lsx_cdft: the same lengths
+ * (powers of 2, in doubles), signs, data layouts and scaling, but with
+ * tables held in a plan made by lsx_fftsse2_plan for the given length. */
+
+typedef struct lsx_fftsse2_plan lsx_fftsse2_plan_t;
+
+lsx_fftsse2_plan_t * lsx_fftsse2_plan(int len);
+void lsx_fftsse2_free(lsx_fftsse2_plan_t * plan);
+void lsx_fftsse2_rdft(int len, int type, double * d,
+    lsx_fftsse2_plan_t const * plan);
+void lsx_fftsse2_cdft(int len, int type, double * d,
+    lsx_fftsse2_plan_t const * plan);
@@ -622,6 +622,7 @@ static sox_format_t * open_read(
   return ft;
 
 error:
+  lsx_unmap_input(ft);
   if (ft->fp && ft->fp != stdin)
     xfclose(ft->fp, ft->io_type);
   free(ft->priv);
@@ -927,8 +928,18 @@ static sox_format_t * open_write(
     }
 
     /* stdout tends to be line-buffered.  Override this */
-    /* to be Full Buffering. */
-    if (setvbuf (ft->fp, NULL, _IOFBF, sizeof(char) * sox_globals.bufsiz)) {
+    /* to be Full Buffering.  For files, supply the buffer: given only a size,
+     * some C libraries (e.g. glibc) use their own default (e.g. 4 KiB). */
+    if (ft->fp != stdout) {
+      size_t output_bufsiz = sox_globals.output_bufsiz? sox_globals.output_bufsiz
+          : max(sox_globals.bufsiz, (size_t)1 << 20);
+      ft->stdio_buf = lsx_malloc(output_bufsiz);
+      if (setvbuf(ft->fp, ft->stdio_buf, _IOFBF, output_bufsiz)) {
+        lsx_fail("Can't set write buffer");
+        goto error;
+      }
+    }
+    else if (setvbuf (ft->fp, NULL, _IOFBF, sizeof(char) * sox_globals.bufsiz)) {
       lsx_fail("Can't set write buffer");
       goto error;
     }
@@ -985,6 +996,7 @@ static sox_format_t * open_write(
 error:
   if (ft->fp && ft->fp != stdout)
     xfclose(ft->fp, ft->io_type);
+  free(ft->stdio_buf);
   free(ft->priv);
   free(ft->filename);
   free(ft->filetype);
@@ -1061,6 +1073,7 @@ int sox_close(sox_format_t * ft)
     else result = ft->handler.stopwrite? (*ft->handler.stopwrite)(ft) : SOX_SUCCESS;
   }
 
+  lsx_unmap_input(ft);
   if (ft->fp == stdin) {
     sox_globals.stdin_in_use_by = NULL;
   } else if (ft->fp == stdout) {
@@ -1070,6 +1083,7 @@ int sox_close(sox_format_t * ft)
     xfclose(ft->fp, ft->io_type);
   }
 
+  free(ft->stdio_buf);
   free(ft->priv);
   free(ft->filename);
   free(ft->filetype);
@@ -22,6 +22,10 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+  #include <sys/mman.h>
+  #define USE_MMAP 1
+#endif
 
 void lsx_fail_errno(sox_format_t * ft, int sox_errno, const char *fmt, ...)
 {
@@ -102,6 +106,69 @@ size_t lsx_readbuf(sox_format_t * ft, void *buf, size_t len)
   return ret;
 }
 
+/* A regular input file of uncompressed samples may be mapped into memory
+ * (by lsx_rawstart), so that the raw readers can decode straight from it via
+ * lsx_read_mapped, rather than having the data copied (by lsx_readbuf) into
+ * a buffer first.  The stdio stream remains the reference for the file
+ * position, so that other I/O functions may be freely interleaved.  Note
+ * that if the file is truncated (by another process) while being read, an
+ * access to the mapping beyond its new end raises SIGBUS, where fread would
+ * have given a short read. */
+void lsx_map_input(sox_format_t * ft)
+{
+#ifdef USE_MMAP
+  struct stat st;
+  int fd = ft->fp? fileno((FILE*)ft->fp) : -1;
+  void * map;
+
+  if (fd < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+      (uint64_t)st.st_size != (size_t)st.st_size)
+    return;
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    return;
+#ifdef HAVE_MADVISE
+  madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+  ft->map = map;
+  ft->map_length = (uint64_t)st.st_size;
+  lsx_debug("mapped %" PRIu64 " bytes of `%s'", ft->map_length, ft->filename);
+#else
+  (void)ft;
+#endif
+}
+
+void lsx_unmap_input(sox_format_t * ft)
+{
+#ifdef USE_MMAP
+  if (ft->map)
+    munmap(ft->map, (size_t)ft->map_length);
+#endif
+  ft->map = NULL;
+  ft->map_length = 0;
+}
+
+/* Returns a pointer to up to *n items, each of the given byte size, at the
+ * current position of a mapped input file, and advances the position past
+ * them; *n is set to the number of items available, or 0 if the file is not
+ * mapped (in which case the return value is null). */
+void const * lsx_read_mapped(sox_format_t * ft, size_t size, size_t * n)
+{
+  off_t pos;
+
+  if (!ft->map || (pos = lsx_tell(ft)) < 0 || (uint64_t)pos >= ft->map_length) {
+    *n = 0;
+    return NULL;
+  }
+  *n = min(*n, (size_t)((ft->map_length - (uint64_t)pos) / size));
+  if (*n && lsx_seeki(ft, (off_t)(*n * size), SEEK_CUR) != SOX_SUCCESS) {
+    *n = 0;
+    return NULL;
+  }
+  ft->tell_off += *n * size;
+  return (char const *)ft->map + pos;
+}
+
 /* Skip input without seeking. */
 int lsx_skipbytes(sox_format_t * ft, size_t n)
 {
@@ -358,18 +425,22 @@ static uint8_t const cswap[256] = {
   ((p)[2] | ((p)[1] << 8) | ((p)[0] << 16)))
 
 /* This (slower) macro works for unaligned types (e.g. 3-byte types)
-   that need to be unpacked. */
+   that need to be unpacked; it goes via a buffer on the stack. */
+#define PACK_CHUNK 2048
 #define READ_FUNC_UNPACK(type, size, ctype, twiddle) \
   size_t lsx_read_ ## type ## _buf( \
       sox_format_t * ft, ctype *buf, size_t len) \
   { \
-    size_t n, nread; \
-    uint8_t *data = lsx_malloc(size * len); \
-    nread = lsx_readbuf(ft, data, len * size) / size; \
-    for (n = 0; n < nread; n++) \
-      buf[n] = sox_unpack ## size(data + n * size); \
-    free(data); \
-    return n; \
+    size_t n, i, chunk, nread = 0; \
+    uint8_t data[PACK_CHUNK * size]; \
+    do { \
+      chunk = min(len - nread, PACK_CHUNK); \
+      n = lsx_readbuf(ft, data, chunk * size) / size; \
+      for (i = 0; i < n; i++) \
+        *buf++ = sox_unpack ## size(data + i * size); \
+      nread += n; \
+    } while (n == chunk && nread < len); \
+    return nread; \
   }
 
 READ_FUNC(b, 1, uint8_t, TWIDDLE_BYTE)
@@ -489,18 +560,21 @@ end:
 } while (0)
 
 /* This (slower) macro works for unaligned types (e.g. 3-byte types)
-   that need to be packed. */
+   that need to be packed; it goes via a buffer on the stack. */
 #define WRITE_FUNC_PACK(type, size, ctype, twiddle) \
   size_t lsx_write_ ## type ## _buf( \
       sox_format_t * ft, ctype *buf, size_t len) \
   { \
-    size_t n, nwritten; \
-    uint8_t *data = lsx_malloc(size * len); \
-    for (n = 0; n < len; n++) \
-      sox_pack ## size(data + n * size, buf[n]); \
-    nwritten = lsx_writebuf(ft, data, len * size); \
-    free(data); \
-    return nwritten / size; \
+    size_t n, i, chunk, nwritten = 0; \
+    uint8_t data[PACK_CHUNK * size]; \
+    do { \
+      chunk = min(len - nwritten, PACK_CHUNK); \
+      for (i = 0; i < chunk; i++) \
+        sox_pack ## size(data + i * size, buf[nwritten + i]); \
+      n = lsx_writebuf(ft, data, chunk * size) / size; \
+      nwritten += n; \
+    } while (n == chunk && nwritten < len); \
+    return nwritten; \
   }
 
 WRITE_FUNC(b, 1, uint8_t, TWIDDLE_BYTE)
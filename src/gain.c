@@ -28,7 +28,19 @@ typedef struct {
   double        mult, reclaim, rms, limiter;
   off_t         num_samples;
   sox_sample_t  min, max;
-  FILE          * tmp_file;
+  lsx_spill_t   * spill;
+  sox_uint64_t  spill_pos;
+
+  /* -n -w: normalise in one pass, with a look-ahead window of audio held in
+   * a delay line.  Each frame requires at most fixed_gain / the peak level up
+   * to & including it; this never rises, so the mean of it over a frame and
+   * the window of frames that follow is a smoothly ramping gain that never
+   * exceeds what that frame requires. */
+  double        window;       /* In seconds; 0 to normalise in two passes */
+  sox_sample_t  * delay;
+  double        * required;   /* The required gain of each delayed frame */
+  size_t        window_len, delay_pos, delay_fill, drain_pos;
+  double        peak, sum;    /* sum: of required over frames in the window */
 } priv_t;
 
 static int create(sox_effect_t * effp, int argc, char * * argv)
@@ -45,6 +57,16 @@ static int create(sox_effect_t * effp, int argc, char * * argv)
       case 'r': p->do_scan = p->do_restore = sox_true; break;
       case 'h': p->make_headroom = sox_true; break;
       case 'l': p->do_limiter = sox_true; break;
+      case 'w': {
+        char * end_ptr;
+        if (q[1] || argc < 2 || (p->window = strtod(argv[1], &end_ptr)) <= 0
+            || *end_ptr) {
+          lsx_fail("-w must be followed by a look-ahead time in seconds");
+          return lsx_usage(effp);
+        }
+        --argc, ++argv;
+        break;
+      }
       default: lsx_fail("invalid option `-%c'", *q); return lsx_usage(effp);
     }
   if ((p->do_equalise + p->do_balance + p->do_balance_no_clip + p->do_restore)/ sox_true > 1) {
@@ -55,6 +77,13 @@ static int create(sox_effect_t * effp, int argc, char * * argv)
     lsx_fail("only one of -n, -r may be given");
     return SOX_EOF;
   }
+  if (p->window && (!p->do_normalise || p->do_equalise || p->do_balance ||
+        p->do_balance_no_clip)) {
+    lsx_fail("-w may be given only with -n, and not with -e, -B, -b");
+    return SOX_EOF;
+  }
+  if (p->window)
+    p->do_scan = sox_false;
   if (p->do_limiter && p->make_headroom) {
     lsx_fail("only one of -l, -h may be given");
     return SOX_EOF;
@@ -79,35 +108,148 @@ static int start(sox_effect_t * effp)
     effp->out_signal.mult = p->make_headroom? &p->fixed_gain : NULL;
     if (!p->do_equalise && !p->do_balance && !p->do_balance_no_clip)
       effp->flows = 1; /* essentially a conditional SOX_EFF_MCHAN */
+    if (!p->do_scan && !p->window)
+      effp->handler.flags |= SOX_EFF_FUSE; /* Just a fixed gain */
   }
   p->mult = 0;
   p->max = 1;
   p->min = -1;
   if (p->do_scan) {
-    p->tmp_file = lsx_tmpfile();
-    if (p->tmp_file == NULL) {
-      lsx_fail("can't create temporary file: %s", strerror(errno));
-      return SOX_EOF;
-    }
+    p->spill = lsx_spill_create();
+    p->spill_pos = 0;
+  }
+  if (p->window) {
+    p->window_len = max(p->window * effp->in_signal.rate + .5, 1);
+    p->delay = lsx_calloc(p->window_len * effp->in_signal.channels, sizeof(*p->delay));
+    p->required = lsx_calloc(p->window_len, sizeof(*p->required));
+    p->delay_pos = p->delay_fill = p->drain_pos = 0;
+    p->peak = 1. / SOX_SAMPLE_MAX;
+    lsx_report("look-ahead latency %g s", p->window_len / effp->in_signal.rate);
   }
   if (p->do_limiter)
     p->limiter = (1 - 1 / p->fixed_gain) * (1. / SOX_SAMPLE_MAX);
-  else if (p->fixed_gain == floor(p->fixed_gain) && !p->do_scan)
+  else if (p->fixed_gain == floor(p->fixed_gain) && !p->do_scan && !p->window)
     effp->out_signal.precision = effp->in_signal.precision;
   return SOX_SUCCESS;
 }
 
+/* The peak level of a frame (relative to full scale), measured as by the
+ * two-pass -n (see stop) */
+static double frame_level(sox_sample_t const * x, unsigned channels)
+{
+  double level = 0;
+  unsigned c;
+
+  for (c = 0; c < channels; ++c)
+    level = max(level, x[c] < 0? x[c] / (double)SOX_SAMPLE_MIN : x[c] / (double)SOX_SAMPLE_MAX);
+  return level;
+}
+
+static sox_sample_t * amplify(sox_effect_t * effp, sox_sample_t * obuf,
+    sox_sample_t const * ibuf, size_t len, double mult)
+{
+  priv_t * p = (priv_t *)effp->priv;
+
+  if (!p->do_limiter) for (; len; --len, ++ibuf)
+    *obuf++ = SOX_ROUND_CLIP_COUNT(*ibuf * mult, effp->clips);
+  else for (; len; --len, ++ibuf) {
+    double d = *ibuf * mult;
+    *obuf++ = d < 0 ? 1 / (1 / d - p->limiter) - .5 :
+              d > 0 ? 1 / (1 / d + p->limiter) + .5 : 0;
+  }
+  return obuf;
+}
+
+/* Outputs the frame in the delay line at pos, with the mean of the required
+ * gain over it and the n - 1 frames that follow it, the last of which has
+ * required gain `last'.  As the required gain never rises, the n are all the
+ * same if last is the same as at pos, so then (without the rounding in sum)
+ * the gain is exactly that of the two-pass -n. */
+static sox_sample_t * lookahead_output(sox_effect_t * effp, sox_sample_t * obuf,
+    size_t pos, size_t n, double last)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  unsigned channels = effp->in_signal.channels;
+  double gain = last == p->required[pos]? last :
+      min(p->sum / n, p->required[pos]); /* min: for rounding */
+
+  obuf = amplify(effp, obuf, p->delay + pos * channels, channels, gain);
+  p->sum -= p->required[pos];
+  return obuf;
+}
+
+/* Once the delay line has been filled (or, for short audio, at the end), all
+ * of the frames in it are known, so they are given the gain of the loudest */
+static void lookahead_fill(priv_t * p)
+{
+  size_t i;
+  for (i = 0; i < p->delay_fill; ++i)
+    p->required[i] = p->fixed_gain / p->peak;
+  p->sum = p->delay_fill * (p->fixed_gain / p->peak);
+}
+
+static int lookahead_flow(sox_effect_t * effp, const sox_sample_t * ibuf,
+    sox_sample_t * obuf, size_t * isamp, size_t * osamp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  unsigned channels = effp->in_signal.channels;
+  size_t ilen = *isamp / channels, olen = *osamp / channels;
+  size_t len = min(ilen, p->window_len - p->delay_fill + olen), i;
+  sox_sample_t * obuf0 = obuf;
+
+  for (i = 0; i < len; ++i, ibuf += channels) {
+    size_t pos = p->delay_pos;
+    double level = frame_level(ibuf, channels);
+
+    p->peak = max(p->peak, level);
+    if (p->delay_fill < p->window_len) {
+      if (++p->delay_fill == p->window_len)
+        lookahead_fill(p);
+    }
+    else {
+      double required = p->fixed_gain / p->peak;
+      p->sum += required;
+      obuf = lookahead_output(effp, obuf, pos, p->window_len + 1, required);
+      p->required[pos] = required;
+    }
+    memcpy(p->delay + pos * channels, ibuf, channels * sizeof(*ibuf));
+    p->delay_pos = (pos + 1) % p->window_len;
+  }
+  *isamp = len * channels;
+  *osamp = obuf - obuf0;
+  return SOX_SUCCESS;
+}
+
+static int lookahead_drain(sox_effect_t * effp, sox_sample_t * obuf, size_t * osamp)
+{
+  priv_t * p = (priv_t *)effp->priv;
+  size_t olen = *osamp / effp->in_signal.channels;
+  sox_sample_t * obuf0 = obuf;
+
+  if (p->delay_fill < p->window_len) { /* All the audio is in the delay line */
+    lookahead_fill(p);
+    p->delay_pos = 0;
+    p->window_len = p->delay_fill;
+  }
+  for (; olen && p->drain_pos < p->window_len; --olen, ++p->drain_pos)
+    obuf = lookahead_output(effp, obuf, (p->delay_pos + p->drain_pos) %
+        p->window_len, p->window_len - p->drain_pos, p->required[
+        (p->delay_pos + p->window_len - 1) % p->window_len]);
+  *osamp = obuf - obuf0;
+  return SOX_SUCCESS;
+}
+
 static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
     sox_sample_t * obuf, size_t * isamp, size_t * osamp)
 {
   priv_t * p = (priv_t *)effp->priv;
   size_t len;
 
+  if (p->window)
+    return lookahead_flow(effp, ibuf, obuf, isamp, osamp);
   if (p->do_scan) {
-    if (fwrite(ibuf, sizeof(*ibuf), *isamp, p->tmp_file) != *isamp) {
-      lsx_fail("error writing temporary file: %s", strerror(errno));
+    if (lsx_spill_write(p->spill, ibuf, *isamp) != SOX_SUCCESS)
       return SOX_EOF;
-    }
     if (p->do_balance && !p->do_normalise)
       for (len = *isamp; len; --len, ++ibuf) {
         double d = SOX_SAMPLE_TO_FLOAT_64BIT(*ibuf, effp->clips);
@@ -130,14 +272,8 @@ static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
   }
   else {
     double mult = ((priv_t *)(effp - effp->flow)->priv)->fixed_gain;
-    len = *isamp = *osamp = min(*isamp, *osamp);
-    if (!p->do_limiter) for (; len; --len, ++ibuf)
-      *obuf++ = SOX_ROUND_CLIP_COUNT(*ibuf * mult, effp->clips);
-    else for (; len; --len, ++ibuf) {
-      double d = *ibuf * mult;
-      *obuf++ = d < 0 ? 1 / (1 / d - p->limiter) - .5 :
-                d > 0 ? 1 / (1 / d + p->limiter) + .5 : 0;
-    }
+    *isamp = *osamp = min(*isamp, *osamp);
+    amplify(effp, obuf, ibuf, *isamp, mult);
   }
   return SOX_SUCCESS;
 }
@@ -152,7 +288,7 @@ static void start_drain(sox_effect_t * effp)
     for (i = 0; i < effp->flows; ++i) {
       priv_t * q = (priv_t *)(effp - effp->flow + i)->priv;
       max_rms = max(max_rms, sqrt(q->rms / q->num_samples));
-      rewind(q->tmp_file);
+      q->spill_pos = 0;
     }
     for (i = 0; i < effp->flows; ++i) {
       priv_t * q = (priv_t *)(effp - effp->flow + i)->priv;
@@ -173,7 +309,7 @@ static void start_drain(sox_effect_t * effp)
       double this_peak = max(q->max / max, q->min / (double)SOX_SAMPLE_MIN);
       max_peak = max(max_peak, this_peak);
       q->mult = p->fixed_gain / this_peak;
-      rewind(q->tmp_file);
+      q->spill_pos = 0;
     }
     for (i = 0; i < effp->flows; ++i) {
       priv_t * q = (priv_t *)(effp - effp->flow + i)->priv;
@@ -187,7 +323,7 @@ static void start_drain(sox_effect_t * effp)
       else p->mult = p->reclaim;
     }
     p->mult *= p->fixed_gain;
-    rewind(p->tmp_file);
+    p->spill_pos = 0;
   }
 }
 
@@ -199,21 +335,16 @@ static int drain(sox_effect_t * effp, sox_sample_t * obuf, size_t * osamp)
 
   *osamp -= *osamp % effp->in_signal.channels;
 
+  if (p->window)
+    return lookahead_drain(effp, obuf, osamp);
   if (p->do_scan) {
     if (!p->mult)
       start_drain(effp);
-    len = fread(obuf, sizeof(*obuf), *osamp, p->tmp_file);
-    if (len != *osamp && !feof(p->tmp_file)) {
-      lsx_fail("error reading temporary file: %s", strerror(errno));
-      result = SOX_EOF;
-    }
-    if (!p->do_limiter) for (*osamp = len; len; --len, ++obuf)
-      *obuf = SOX_ROUND_CLIP_COUNT(*obuf * p->mult, effp->clips);
-    else for (*osamp = len; len; --len) {
-      double d = *obuf * p->mult;
-      *obuf++ = d < 0 ? 1 / (1 / d - p->limiter) - .5 :
-                d > 0 ? 1 / (1 / d + p->limiter) + .5 : 0;
-    }
+    len = min(*osamp, lsx_spill_length(p->spill) - p->spill_pos);
+    if (lsx_spill_read(p->spill, p->spill_pos, obuf, len) != SOX_SUCCESS)
+      len = 0, result = SOX_EOF;
+    p->spill_pos += len;
+    amplify(effp, obuf, obuf, *osamp = len, p->mult);
   }
   else *osamp = 0;
   return result;
@@ -223,7 +354,9 @@ static int stop(sox_effect_t * effp)
 {
   priv_t * p = (priv_t *)effp->priv;
   if (p->do_scan)
-    fclose(p->tmp_file); /* auto-deleted by lsx_tmpfile */
+    lsx_spill_delete(p->spill);
+  free(p->delay);
+  free(p->required);
   return SOX_SUCCESS;
 }
 
@@ -233,13 +366,14 @@ sox_effect_handler_t const * lsx_gain_effect_fn(void)
     "gain", NULL, SOX_EFF_GAIN,
     create, start, flow, drain, stop, NULL, sizeof(priv_t)};
   static char const * lines[] = {
-    "[-e|-b|-B|-r] [-n] [-l|-h] [gain-dB]",
+    "[-e|-b|-B|-r] [-n [-w seconds]] [-l|-h] [gain-dB]",
     "-e\t Equalise channels: peak to that with max peak;",
     "-B\t Balance channels: rms to that with max rms; no clip protection",
     "-b\t Balance channels: rms to that with max rms; clip protection",
     "\t   Note -Bn = -bn",
     "-r\t Reclaim headroom (as much as possible without clipping); see -h",
     "-n\t Norm file to 0dBfs(output precision); gain-dB, if present, usually <0",
+    "-w\t With -n, norm in one pass, looking ahead this many seconds",
     "-l\t Use simple limiter",
     "-h\t Apply attenuation for headroom for subsequent effects; gain-dB, if",
     "\t   present, is subject to reclaim by a subsequent gain -r",
@@ -134,7 +134,15 @@ static sox_globals_t s_sox_globals = {
   NULL,            /* char       * tmp_path */
   sox_false,       /* sox_bool     use_magic */
   sox_false,       /* sox_bool     use_threads */
-  10               /* size_t       log2_dft_min_size */
+  10,              /* size_t       log2_dft_min_size */
+  0,               /* size_t       pipeline_stages */
+  0,               /* size_t       num_threads */
+  4096,            /* size_t       threads_min_samples */
+  NULL,            /* char const * fft_backend */
+  14,              /* size_t       log2_dft_partition_size */
+  sox_false,       /* sox_bool     io_threads */
+  0,               /* size_t       output_bufsiz */
+  (size_t)64 << 20 /* size_t       spill_bufsiz */
 };
 
 sox_globals_t * sox_get_globals(void)
@@ -29,6 +29,11 @@
   #include <unistd.h>
 #endif
 
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+  #include <sys/mman.h>
+  #define USE_MMAP 1
+#endif
+
 #if defined(_MSC_VER) || defined(__MINGW32__)
   #define MKTEMP_X _O_BINARY|_O_TEMPORARY
 #else
@@ -114,3 +119,119 @@ FILE * lsx_tmpfile(void)
   lsx_debug("tmpfile()");
   return tmpfile();
 }
+
+/* A spill store holds the audio that an effect (e.g. reverse) must keep
+ * until it has seen all of its input.  The first sox_globals.spill_bufsiz
+ * bytes are kept in memory; any more are written, in large blocks, to a
+ * temporary file, which (where possible) is mapped into memory for reading,
+ * so that reading in any order needs no seeks. */
+struct lsx_spill {
+  sox_sample_t   * mem;         /* The first mem_len samples */
+  size_t         mem_len, mem_size;
+  FILE           * file;        /* The rest, or null if none */
+  char           * file_buf;    /* stdio buffer for file */
+  sox_uint64_t   file_len;      /* Samples in file */
+  sox_uint64_t   file_pos;      /* stdio position in file (in samples) */
+  sox_bool       reading;
+  sox_sample_t   * map;         /* file mapped into memory, or null */
+};
+
+#define SPILL_FILE_BUFSIZ ((size_t)1 << 20)
+
+lsx_spill_t * lsx_spill_create(void)
+{
+  return lsx_calloc(1, sizeof(lsx_spill_t));
+}
+
+int lsx_spill_write(lsx_spill_t * s, sox_sample_t const * buf, size_t n)
+{
+  size_t mem_max = sox_globals.spill_bufsiz / sizeof(*buf);
+  size_t k = min(n, mem_max - min(s->mem_len, mem_max));
+
+  if (k) {
+    if (s->mem_len + k > s->mem_size) {
+      s->mem_size = min(max(s->mem_len + k, s->mem_size * 2), mem_max);
+      s->mem = lsx_realloc(s->mem, s->mem_size * sizeof(*s->mem));
+    }
+    memcpy(s->mem + s->mem_len, buf, k * sizeof(*buf));
+    s->mem_len += k;
+    buf += k, n -= k;
+  }
+  if (n) {
+    if (!s->file) {
+      if (!(s->file = lsx_tmpfile())) {
+        lsx_fail("can't create temporary file: %s", strerror(errno));
+        return SOX_EOF;
+      }
+      s->file_buf = lsx_malloc(SPILL_FILE_BUFSIZ);
+      setvbuf(s->file, s->file_buf, _IOFBF, SPILL_FILE_BUFSIZ);
+    }
+    if (fwrite(buf, sizeof(*buf), n, s->file) != n) {
+      lsx_fail("error writing temporary file: %s", strerror(errno));
+      return SOX_EOF;
+    }
+    s->file_pos = s->file_len += n;
+  }
+  return SOX_SUCCESS;
+}
+
+sox_uint64_t lsx_spill_length(lsx_spill_t const * s)
+{
+  return s->mem_len + s->file_len;
+}
+
+/* Reads the n samples at pos; once reading has begun, no more may be written */
+int lsx_spill_read(lsx_spill_t * s, sox_uint64_t pos, sox_sample_t * buf, size_t n)
+{
+  size_t k = pos < s->mem_len? min(n, s->mem_len - (size_t)pos) : 0;
+
+  if (k) {
+    memcpy(buf, s->mem + pos, k * sizeof(*buf));
+    buf += k, n -= k, pos += k;
+  }
+  if (!n)
+    return SOX_SUCCESS;
+  pos -= s->mem_len;
+  if (!s->reading) {
+    s->reading = sox_true;
+    fflush(s->file);
+#ifdef USE_MMAP
+    if (s->file_len <= SOX_SIZE_MAX / sizeof(*buf)) {
+      void * map = mmap(NULL, (size_t)s->file_len * sizeof(*buf), PROT_READ,
+          MAP_SHARED, fileno(s->file), 0);
+      if (map != MAP_FAILED)
+        s->map = map;
+    }
+#endif
+  }
+  if (s->map) {
+    memcpy(buf, s->map + pos, n * sizeof(*buf));
+    return SOX_SUCCESS;
+  }
+  if (pos != s->file_pos &&
+      fseeko(s->file, (off_t)(pos * sizeof(*buf)), SEEK_SET)) {
+    lsx_fail("error seeking temporary file: %s", strerror(errno));
+    return SOX_EOF;
+  }
+  s->file_pos = pos + n;
+  if (fread(buf, sizeof(*buf), n, s->file) != n) {
+    lsx_fail("error reading temporary file: %s", strerror(errno));
+    return SOX_EOF;
+  }
+  return SOX_SUCCESS;
+}
+
+void lsx_spill_delete(lsx_spill_t * s)
+{
+  if (s) {
+#ifdef USE_MMAP
+    if (s->map)
+      munmap(s->map, (size_t)s->file_len * sizeof(*s->map));
+#endif
+    if (s->file)
+      fclose(s->file); /* auto-deleted by lsx_tmpfile */
+    free(s->file_buf);
+    free(s->mem);
+    free(s);
+  }
+}
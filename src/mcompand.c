@@ -72,6 +72,7 @@ typedef struct {
   size_t band_buf_len;
   size_t delay_buf_size;/* Size of delay_buf in samples */
   comp_band_t *bands;
+  double max_error_dB;  /* Of the bands' tables of gains; 0 for exact */
 
   char *arg; /* copy of current argument */
 } priv_t;
@@ -166,9 +167,17 @@ static int getopts(sox_effect_t * effp, int argc, char **argv)
 {
   char *subargv[6], *cp;
   size_t subargc, i;
+  lsx_getopt_t optstate;
+  int opt;
 
   priv_t * c = (priv_t *) effp->priv;
-  --argc, ++argv;
+  c->max_error_dB = LSX_COMPANDT_MAX_ERROR_DB;
+  lsx_getopt_init(argc, argv, "+e:", NULL, lsx_getopt_flag_none, 1, &optstate);
+  while ((opt = lsx_getopt(&optstate)) != -1) switch (opt) {
+    GETOPT_LOCAL_NUMERIC(optstate, 'e', c->max_error_dB, 0, 6)
+    default: lsx_fail("invalid option `-%c'", optstate.opt); return lsx_usage(effp);
+  }
+  argc -= optstate.ind, argv += optstate.ind;
 
   c->band_buf1 = c->band_buf2 = c->band_buf3 = 0;
   c->band_buf_len = 0;
@@ -252,6 +261,8 @@ static int start(sox_effect_t * effp)
 
     if (l->topfreq != 0)
       crossover_setup(effp, &l->filter, l->topfreq);
+    lsx_compandt_table(&l->transfer_fn,
+        c->max_error_dB, LSX_COMPANDT_MAX_PER_OCTAVE);
   }
   return (SOX_SUCCESS);
 }
@@ -266,15 +277,15 @@ static void doVolume(double *v, double samp, comp_band_t * l, size_t chan)
   double s = samp/(~((sox_sample_t)1<<31));
   double delta = s - *v;
 
-  if (delta > 0.0) /* increase volume according to attack rate */
-    *v += delta * l->attackRate[chan];
-  else             /* reduce volume according to decay rate */
-    *v += delta * l->decayRate[chan];
+  /* Increase volume according to attack rate, or reduce it according to
+   * decay rate (as a select rather than a branch; see compand) */
+  *v += delta * (delta > 0.0? l->attackRate[chan] : l->decayRate[chan]);
 }
 
 static int sox_mcompand_flow_1(sox_effect_t * effp, priv_t * c, comp_band_t * l, const sox_sample_t *ibuf, sox_sample_t *obuf, size_t len, size_t filechans)
 {
   size_t idone, odone;
+  double level_out_lin = 0;
 
   for (idone = 0, odone = 0; idone < len; ibuf += filechans) {
     size_t chan;
@@ -298,10 +309,11 @@ static int sox_mcompand_flow_1(sox_effect_t * effp, priv_t * c, comp_band_t * l,
     /* Volume memory is updated: perform compand */
     for (chan = 0; chan < filechans; ++chan) {
       int ch = l->expectedChannels > 1 ? chan : 0;
-      double level_in_lin = l->volume[ch];
-      double level_out_lin = lsx_compandt(&l->transfer_fn, level_in_lin);
       double checkbuf;
 
+      if (!chan || ch) /* Once per frame if channels are companded as one */
+        level_out_lin = lsx_compandt_lookup(&l->transfer_fn, l->volume[ch]);
+
       if (c->delay_buf_size <= 0) {
         checkbuf = ibuf[chan] * level_out_lin;
         SOX_SAMPLE_CLIP_COUNT(checkbuf, effp->clips);
@@ -509,7 +521,7 @@ const sox_effect_handler_t *lsx_mcompand_effect_fn(void)
 {
   static sox_effect_handler_t handler = {
     "mcompand",
-    "quoted_compand_args [crossover_frequency[k] quoted_compand_args [...]]\n"
+    "[-e max-error-dB] quoted_compand_args [crossover_frequency[k] quoted_compand_args [...]]\n"
     "\n"
     "quoted_compand_args are as for the compand effect:\n"
     "\n"
@@ -195,6 +195,15 @@ static const char* const twolame_library_names[] =
   TWOLAME_FUNC(f,x, int, twolame_encode_flush, (twolame_options *, unsigned char *, int)) \
   TWOLAME_FUNC(f,x, void, twolame_close, (twolame_options **))
 
+#ifdef HAVE_MAD_H
+/* An entry in the seek index: the file offset of an audio frame, and the
+ * number of samples (per channel) that precede it */
+typedef struct {
+  off_t                   offset;
+  uint64_t                sample;
+} mp3_index_t;
+#endif
+
 /* Private data */
 typedef struct mp3_priv_t {
   unsigned char *mp3_buffer;
@@ -207,6 +216,8 @@ typedef struct mp3_priv_t {
   mad_timer_t             Timer;
   ptrdiff_t               cursamp;
   size_t                  FrameCount;
+  mp3_index_t             * index;  /* Built by the first seek */
+  size_t                  index_len;
   LSX_DLENTRIES_TO_PTRS(MAD_FUNC_ENTRIES, mad_dl);
 #endif /*HAVE_MAD_H*/
 
@@ -343,15 +354,16 @@ static int sox_mp3_inputtag(sox_format_t * ft)
     return rc;
 }
 
-static sox_bool sox_mp3_vbrtag(sox_format_t *ft)
+/* Whether the frame just decoded is a Xing/Info tag rather than audio */
+static sox_bool is_vbrtag(struct mad_header const * header,
+    struct mad_stream const * stream)
 {
-    priv_t *p = ft->priv;
-    struct mad_bitptr *anc = &p->Stream.anc_ptr;
+    struct mad_bitptr const *anc = &stream->anc_ptr;
 
-    if (p->Frame.header.layer != MAD_LAYER_III)
+    if (header->layer != MAD_LAYER_III)
         return sox_false;
 
-    if (p->Stream.anc_bitlen < 32)
+    if (stream->anc_bitlen < 32)
         return sox_false;
 
     if (!memcmp(anc->byte, "Xing", 4) ||
@@ -361,6 +373,12 @@ static sox_bool sox_mp3_vbrtag(sox_format_t *ft)
     return sox_false;
 }
 
+static sox_bool sox_mp3_vbrtag(sox_format_t *ft)
+{
+    priv_t *p = ft->priv;
+    return is_vbrtag(&p->Frame.header, &p->Stream);
+}
+
 static int startread(sox_format_t * ft)
 {
   priv_t *p = (priv_t *) ft->priv;
@@ -555,23 +573,15 @@ static int stopread(sox_format_t * ft)
   p->mad_stream_finish(&p->Stream);
 
   free(p->mp3_buffer);
+  free(p->index);
   LSX_DLLIBRARY_CLOSE(p, mad_dl);
   return SOX_SUCCESS;
 }
 
-static int sox_mp3seek(sox_format_t * ft, uint64_t offset)
+/* Restarts decoding with fresh libmad state */
+static void reset_decoder(priv_t * p)
 {
-  priv_t   * p = (priv_t *) ft->priv;
-  size_t   initial_bitrate = p->Frame.header.bitrate;
-  size_t   tagsize = 0, consumed = 0;
-  sox_bool vbr = sox_false; /* Variable Bit Rate */
-  sox_bool depadded = sox_false;
-  uint64_t to_skip_samples = 0;
-
-  /* Reset all */
-  lsx_rewind(ft);
   mad_timer_reset(&p->Timer);
-  p->FrameCount = 0;
 
   /* They where opened in startread */
   mad_synth_finish(&p->Synth);
@@ -581,6 +591,156 @@ static int sox_mp3seek(sox_format_t * ft, uint64_t offset)
   p->mad_stream_init(&p->Stream);
   p->mad_frame_init(&p->Frame);
   p->mad_synth_init(&p->Synth);
+}
+
+/* Scans the frame headers of the whole file (as mp3_duration does, but
+ * without extrapolating) to make the seek index.  A Xing/Info tag frame is
+ * not indexed, since (as in startread) it is not decoded as audio. */
+static void build_index(sox_format_t * ft)
+{
+  priv_t              * p = (priv_t *) ft->priv;
+  struct mad_stream   mad_stream;
+  struct mad_header   mad_header;
+  struct mad_frame    mad_frame;
+  size_t              tagsize, alloc = 0;
+  sox_bool            depadded = sox_false, first = sox_true;
+  uint64_t            num_samples = 0;
+
+  lsx_rewind(ft);
+  p->mad_stream_init(&mad_stream);
+  p->mad_header_init(&mad_header);
+  p->mad_frame_init(&mad_frame);
+
+  do {  /* Read data from the MP3 file */
+    size_t read, padding = 0;
+    size_t leftover = mad_stream.bufend - mad_stream.next_frame;
+    off_t base = lsx_tell(ft) - (off_t)leftover; /* Offset of mp3_buffer[0] */
+
+    memmove(p->mp3_buffer, mad_stream.next_frame, leftover);
+    read = lsx_readbuf(ft, p->mp3_buffer + leftover, p->mp3_buffer_size - leftover);
+    if (read == 0)
+      break;
+    for (; !depadded && padding < read && !p->mp3_buffer[padding]; ++padding);
+    depadded = sox_true;
+    p->mad_stream_buffer(&mad_stream, p->mp3_buffer + padding, leftover + read - padding);
+
+    while (sox_true) {  /* Decode frame headers */
+      mad_stream.error = MAD_ERROR_NONE;
+      if (p->mad_header_decode(&mad_header, &mad_stream) == -1) {
+        if (mad_stream.error == MAD_ERROR_BUFLEN)
+          break;  /* Normal behaviour; get some more data from the file */
+        if (!MAD_RECOVERABLE(mad_stream.error)) {
+          lsx_warn("unrecoverable MAD error");
+          break;
+        }
+        if (mad_stream.error == MAD_ERROR_LOSTSYNC) {
+          unsigned available = (mad_stream.bufend - mad_stream.this_frame);
+          tagsize = tagtype(mad_stream.this_frame, (size_t) available);
+          if (tagsize) {   /* It's some ID3 tags, so just skip */
+            if (tagsize >= available) {
+              lsx_seeki(ft, (off_t)(tagsize - available), SEEK_CUR);
+              depadded = sox_false;
+            }
+            p->mad_stream_skip(&mad_stream, min(tagsize, available));
+          }
+        }
+        continue; /* Not an audio frame */
+      }
+
+      if (first) {
+        first = sox_false;
+        mad_frame.header = mad_header;
+        if (p->mad_frame_decode(&mad_frame, &mad_stream) == 0 &&
+            is_vbrtag(&mad_frame.header, &mad_stream))
+          continue;
+      }
+      if (p->index_len == alloc)
+        p->index = lsx_realloc(p->index, (alloc = max(2 * alloc, 1024)) * sizeof(*p->index));
+      p->index[p->index_len].offset = base + (mad_stream.this_frame - p->mp3_buffer);
+      p->index[p->index_len++].sample = num_samples;
+      num_samples += MAD_NSBSAMPLES(&mad_header) * 32;
+    }
+  } while (mad_stream.error == MAD_ERROR_BUFLEN);
+
+  p->mad_frame_finish(&mad_frame);
+  mad_header_finish(&mad_header);
+  p->mad_stream_finish(&mad_stream);
+  lsx_debug("indexed %" PRIuPTR " frames", p->index_len);
+}
+
+/* Decoding from a frame after a seek needs the bit reservoir (up to 511
+ * bytes of earlier frames) and the synthesis filter state to be as they
+ * would have been, so starts this many bytes, and at least this many
+ * frames, earlier; the earlier frames' audio is discarded */
+#define SEEK_PRIME_BYTES MAXFRAMESIZE
+#define SEEK_PRIME_FRAMES 2
+
+static int seek_by_index(sox_format_t * ft, uint64_t sample)
+{
+  priv_t * p = (priv_t *) ft->priv;
+  size_t lo = 0, hi = p->index_len, i, j;
+
+  while (hi - lo > 1) { /* Find the last frame starting at or before sample */
+    size_t mid = lo + (hi - lo) / 2;
+    if (p->index[mid].sample <= sample)
+      lo = mid;
+    else hi = mid;
+  }
+  for (i = j = lo; j && (i - j < SEEK_PRIME_FRAMES ||
+      p->index[i].offset - p->index[j].offset < SEEK_PRIME_BYTES); --j);
+
+  if (lsx_seeki(ft, p->index[j].offset, SEEK_SET) != SOX_SUCCESS)
+    return SOX_EOF;
+  reset_decoder(p);
+  p->FrameCount = j;
+  if (sox_mp3_input(ft) == SOX_EOF)
+    return SOX_EOF;
+
+  while (j < p->index_len) {
+    if (p->mad_frame_decode(&p->Frame, &p->Stream)) {
+      if (p->Stream.error == MAD_ERROR_BUFLEN) {
+        if (sox_mp3_input(ft) == SOX_EOF)
+          break;
+      }
+      else if (!MAD_RECOVERABLE(p->Stream.error))
+        break;
+      else if (p->Stream.error == MAD_ERROR_LOSTSYNC)
+        sox_mp3_inputtag(ft);
+      else ++j; /* e.g. a priming frame without its reservoir: skipped */
+      continue;
+    }
+    p->FrameCount++;
+    p->mad_timer_add(&p->Timer, p->Frame.header.duration);
+    p->mad_synth_frame(&p->Synth, &p->Frame);
+    if (j >= i) {
+      p->cursamp = sample > p->index[j].sample?
+          min(sample - p->index[j].sample, p->Synth.pcm.length) : 0;
+      return SOX_SUCCESS;
+    }
+    ++j;
+  }
+  lsx_debug("seek failure (frame %" PRIuPTR ")", j);
+  return SOX_EOF;
+}
+
+static int sox_mp3seek(sox_format_t * ft, uint64_t offset)
+{
+  priv_t   * p = (priv_t *) ft->priv;
+  size_t   initial_bitrate = p->Frame.header.bitrate;
+  size_t   tagsize = 0, consumed = 0;
+  sox_bool vbr = sox_false; /* Variable Bit Rate */
+  sox_bool depadded = sox_false;
+  uint64_t to_skip_samples = 0;
+
+  if (!p->index_len)
+    build_index(ft);
+  if (p->index_len)
+    return seek_by_index(ft, offset / ft->signal.channels);
+
+  /* No index (no frames found); scan from the start */
+  lsx_rewind(ft);
+  reset_decoder(p);
+  p->FrameCount = 0;
 
   offset /= ft->signal.channels;
   to_skip_samples = offset;
@@ -42,6 +42,9 @@
   #define sample_t   double
   #define num_coefs4 num_coefs
   #define coefs4_check(i) 1
+  #if defined __SSE2__
+    #define POLY_FIR_SIMD
+  #endif
 #endif
 
 #if defined M_PIl
@@ -52,6 +55,61 @@
 
 #define coef(coef_p, interp_order, fir_len, phase_num, coef_interp_num, fir_coef_num) coef_p[(fir_len) * ((interp_order) + 1) * (phase_num) + ((interp_order) + 1) * (fir_coef_num) + (interp_order - coef_interp_num)]
 
+#if defined POLY_FIR_SIMD
+#include <emmintrin.h>
+
+/* SSE2 convolution of n (even) input samples with one phase of a poly-phase
+ * FIR, two taps per vector.  With coef interpolation, the ORDER + 1 coefs of
+ * each tap are stored together, highest order first (see coef()); LOAD
+ * gathers those of two adjacent taps into one vector per order.  Products
+ * are formed as by the scalar code, but summed in a different order. */
+#define POLY_FIR_SIMD_FN(ORDER, LOAD, INTERP) \
+static sample_t poly_fir##ORDER##_simd(sample_t const * c, \
+    sample_t const * in, int n, sample_t x) \
+{ \
+  __m128d s0 = _mm_setzero_pd(), s1 = s0, v = _mm_set1_pd(x); \
+  __m128d t0, t1, t2, t3, k0, k1, k2, k3; \
+  int j = 0; \
+  for (; j + 3 < n; j += 4, c += 4 * (ORDER + 1)) { \
+    LOAD(c); s0 = _mm_add_pd(s0, _mm_mul_pd(INTERP, _mm_loadu_pd(in + j))); \
+    LOAD(c + 2 * (ORDER + 1)); \
+    s1 = _mm_add_pd(s1, _mm_mul_pd(INTERP, _mm_loadu_pd(in + j + 2))); \
+  } \
+  if (j < n) { \
+    LOAD(c); s0 = _mm_add_pd(s0, _mm_mul_pd(INTERP, _mm_loadu_pd(in + j))); \
+  } \
+  s0 = _mm_add_pd(s0, s1); \
+  (void)v, (void)t0, (void)t1, (void)t2, (void)t3, (void)k1, (void)k2, (void)k3; \
+  return _mm_cvtsd_f64(_mm_add_sd(s0, _mm_unpackhi_pd(s0, s0))); \
+}
+
+#define LOAD0(c) k0 = _mm_loadu_pd(c)
+#define LOAD1(c) t0 = _mm_loadu_pd(c), t1 = _mm_loadu_pd(c + 2), \
+  k1 = _mm_unpacklo_pd(t0, t1), k0 = _mm_unpackhi_pd(t0, t1)
+#define LOAD2(c) t0 = _mm_loadu_pd(c), t1 = _mm_loadu_pd(c + 2), \
+  t2 = _mm_loadu_pd(c + 4), k2 = _mm_shuffle_pd(t0, t1, 2), \
+  k1 = _mm_shuffle_pd(t0, t2, 1), k0 = _mm_shuffle_pd(t1, t2, 2)
+#define LOAD3(c) t0 = _mm_loadu_pd(c), t1 = _mm_loadu_pd(c + 2), \
+  t2 = _mm_loadu_pd(c + 4), t3 = _mm_loadu_pd(c + 6), \
+  k3 = _mm_unpacklo_pd(t0, t2), k2 = _mm_unpackhi_pd(t0, t2), \
+  k1 = _mm_unpacklo_pd(t1, t3), k0 = _mm_unpackhi_pd(t1, t3)
+#define MADD(a, b, c) _mm_add_pd(_mm_mul_pd(a, b), c)
+
+POLY_FIR_SIMD_FN(0, LOAD0, k0)
+POLY_FIR_SIMD_FN(1, LOAD1, MADD(k1, v, k0))
+POLY_FIR_SIMD_FN(2, LOAD2, MADD(MADD(k2, v, k1), v, k0))
+POLY_FIR_SIMD_FN(3, LOAD3, MADD(MADD(MADD(k3, v, k2), v, k1), v, k0))
+
+#undef MADD
+#undef LOAD3
+#undef LOAD2
+#undef LOAD1
+#undef LOAD0
+#undef POLY_FIR_SIMD_FN
+#define poly_fir_simd(order) poly_fir_simd_(order)
+#define poly_fir_simd_(order) poly_fir##order##_simd
+#endif
+
 static sample_t * prepare_coefs(raw_coef_t const * coefs, int num_coefs,
     int num_phases, int interp_order, int multiplier)
 {
@@ -500,23 +558,80 @@ static void rate_flush(rate_t * p)
 
 static void rate_close(rate_t * p)
 {
-  rate_shared_t *shared;
   int i;
 
   if (!p->num_stages)
     return;
 
-  shared = p->stages[0].shared;
-
   for (i = 0; i <= p->num_stages; ++i)
     fifo_delete(&p->stages[i].fifo);
-  free(shared->dft_filter[0].coefs);
-  free(shared->dft_filter[1].coefs);
-  free(shared->poly_fir_coefs);
-  memset(shared, 0, sizeof(*shared));
   free(p->stages);
 }
 
+/*------------------------------- Filter Cache -------------------------------*/
+
+/* Designed filters are kept in a process-wide cache, keyed on everything that
+ * determines them, so that they are shared not only between the channels of
+ * one effect but also with any later rate effect (e.g. for the next file)
+ * making the same conversion.  Designs no longer in use are kept until there
+ * are more than RATE_CACHE_UNUSED_MAX of them. */
+
+#define RATE_CACHE_UNUSED_MAX 8
+
+typedef struct {
+  double     factor, bits, phase, bw_pc, anti_aliasing_pc;
+  int        rolloff, maintain_3dB_pt, interpolator, max_coefs_size;
+  int        noSmallIntOpt, log2_dft_min_size;
+} rate_key_t;
+
+typedef struct rate_cache {
+  struct rate_cache * next;  /* Most recently used first */
+  rate_key_t key;
+  int        refs;
+  rate_shared_t shared;
+} rate_cache_t;
+
+static rate_cache_t * rate_cache = NULL;
+
+/* To be called within critical section rate_cache */
+static rate_cache_t * rate_cache_get(rate_key_t const * key)
+{
+  rate_cache_t * * prev, * c;
+
+  for (prev = &rate_cache; (c = *prev) && memcmp(&c->key, key, sizeof(*key));
+      prev = &c->next);
+  if (c)
+    *prev = c->next;
+  else {
+    c = calloc(1, sizeof(*c));
+    c->key = *key;
+  }
+  c->next = rate_cache, rate_cache = c;
+  ++c->refs;
+  return c;
+}
+
+static void rate_cache_release(rate_cache_t * cached)
+{
+  #pragma omp critical(rate_cache)
+  {
+    rate_cache_t * * prev = &rate_cache, * c;
+    int unused = 0;
+
+    --cached->refs;
+    while ((c = *prev)) {
+      if (!c->refs && ++unused > RATE_CACHE_UNUSED_MAX) {
+        *prev = c->next;
+        free(c->shared.dft_filter[0].coefs);
+        free(c->shared.dft_filter[1].coefs);
+        free(c->shared.poly_fir_coefs);
+        free(c);
+      }
+      else prev = &c->next;
+    }
+  }
+}
+
 /*------------------------------- SoX Wrapper --------------------------------*/
 
 typedef struct {
@@ -525,7 +640,7 @@ typedef struct {
   double          bit_depth, phase, bw_0dB_pc, anti_aliasing_pc;
   sox_bool        use_hi_prec_clock, noIOpt, given_0dB_pt;
   rate_t          rate;
-  rate_shared_t   shared, * shared_ptr;
+  rate_cache_t    * cached;
 } priv_t;
 
 static int create(sox_effect_t * effp, int argc, char **argv)
@@ -544,7 +659,6 @@ static int create(sox_effect_t * effp, int argc, char **argv)
   p->rolloff = rolloff_small;
   p->phase = 50;
   p->max_coefs_size = 400;
-  p->shared_ptr = &p->shared;
 
   while ((c = lsx_getopt(&optstate)) != -1) switch (c) {
     GETOPT_NUMERIC(optstate, 'i', coef_interp, -1, 2)
@@ -629,6 +743,7 @@ static int start(sox_effect_t * effp)
 {
   priv_t * p = (priv_t *) effp->priv;
   double out_rate = p->out_rate != 0 ? p->out_rate : effp->out_signal.rate;
+  rate_key_t key;
 
   if (effp->in_signal.rate == out_rate)
     return SOX_EFF_NULL;
@@ -638,11 +753,33 @@ static int start(sox_effect_t * effp)
 
   effp->out_signal.channels = effp->in_signal.channels;
   effp->out_signal.rate = out_rate;
-  rate_init(&p->rate, p->shared_ptr, effp->in_signal.rate/out_rate,p->bit_depth,
-      p->phase, p->bw_0dB_pc, p->anti_aliasing_pc, p->rolloff, !p->given_0dB_pt,
-      p->use_hi_prec_clock, p->coef_interp, p->max_coefs_size, p->noIOpt);
+
+  memset(&key, 0, sizeof(key)); /* Clear any padding, as compared by memcmp */
+  key.factor = effp->in_signal.rate / out_rate;
+  key.bits = p->bit_depth;
+  key.phase = p->phase;
+  key.bw_pc = p->bw_0dB_pc;
+  key.anti_aliasing_pc = p->anti_aliasing_pc;
+  key.rolloff = p->rolloff;
+  key.maintain_3dB_pt = !p->given_0dB_pt;
+  key.interpolator = p->coef_interp;
+  key.max_coefs_size = p->max_coefs_size;
+  key.noSmallIntOpt = p->noIOpt;
+  key.log2_dft_min_size = sox_globals.log2_dft_min_size;
+
+  /* Filters are designed on first use, so effects starting concurrently
+   * (in different chains) must not use the cache entry until it is filled */
+  #pragma omp critical(rate_cache)
+  {
+    p->cached = rate_cache_get(&key);
+    rate_init(&p->rate, &p->cached->shared, key.factor, p->bit_depth,
+        p->phase, p->bw_0dB_pc, p->anti_aliasing_pc, p->rolloff,
+        !p->given_0dB_pt, p->use_hi_prec_clock, p->coef_interp,
+        p->max_coefs_size, p->noIOpt);
+  }
 
   if (!p->rate.num_stages) {
+    rate_cache_release(p->cached);
     lsx_warn("input and output rates too close, skipping resampling");
     return SOX_EFF_NULL;
   }
@@ -657,11 +794,11 @@ static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
   size_t odone = *osamp;
 
   sample_t const * s = rate_output(&p->rate, NULL, &odone);
-  lsx_save_samples(obuf, s, odone, &effp->clips);
+  lsx_effect_save_samples(effp, obuf, s, odone);
 
   if (*isamp && odone < *osamp) {
     sample_t * t = rate_input(&p->rate, NULL, *isamp);
-    lsx_load_samples(t, ibuf, *isamp);
+    lsx_effect_load_samples(effp, t, ibuf, *isamp);
     rate_process(&p->rate);
   }
   else *isamp = 0;
@@ -681,13 +818,64 @@ static int stop(sox_effect_t * effp)
 {
   priv_t * p = (priv_t *) effp->priv;
   rate_close(&p->rate);
+  rate_cache_release(p->cached);
   return SOX_SUCCESS;
 }
 
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+  while (b) {
+    uint64_t t = a % b;
+    a = b, b = t;
+  }
+  return a;
+}
+
+/* For a client seeking its input ahead of rate: each stage's input position
+ * must step in multiples of its M for its phase to repeat, and the filters
+ * settle after their lengths, in the stage's input samples. */
+sox_bool sox_rate_get_grid(sox_effect_t * effp, sox_uint64_t * grid_in,
+    sox_uint64_t * grid_out, sox_uint64_t * preroll)
+{
+  rate_t const * p = &((priv_t *)effp->priv)->rate;
+  uint64_t num = 1, den = 1, grid = 1, g; /* Stage in per rate in: num/den */
+  double settle = 0;
+  int i;
+
+  for (i = 0; i < p->num_stages; ++i) {
+    stage_t const * s = &p->stages[i];
+    uint64_t L = 1, M = 2;         /* A half-band decimator, unless: */
+    double taps = s->pre_post;
+
+    if (s->use_hi_prec_clock)
+      return sox_false;
+    if (s->fn == dft_stage_fn) {
+      L = s->L;
+      M = s->step.parts.integer < 0? -2 * s->step.parts.integer :
+          s->step.parts.integer;
+      taps = (double)s->shared->dft_filter[s->dft_filter_num].num_taps / L;
+    }
+    else if (s->step.all) {        /* Poly-phase or cubic */
+      if (s->step.parts.fraction)
+        return sox_false;
+      L = max(s->L, 1);
+      M = s->step.parts.integer;
+    }
+    g = M * den / gcd(M * den, num);
+    grid = grid / gcd(grid, g) * g;
+    settle += taps * den / num;
+    num *= L, den *= M, g = gcd(num, den), num /= g, den /= g;
+  }
+  *grid_in = grid;
+  *grid_out = grid * num / den;
+  *preroll = (uint64_t)ceil(settle);
+  return sox_true;
+}
+
 sox_effect_handler_t const * lsx_rate_effect_fn(void)
 {
   static sox_effect_handler_t handler = {
-    "rate", 0, SOX_EFF_RATE, create, start, flow, drain, stop, 0, sizeof(priv_t)
+    "rate", 0, SOX_EFF_RATE | SOX_EFF_FLOAT, create, start, flow, drain, stop, 0, sizeof(priv_t)
   };
   static char const * lines[] = {
     "[-q|-l|-m|-h|-v] [override-options] RATE[k]",
@@ -33,6 +33,18 @@
 #else
   #error COEF_INTERP
 #endif
+#if defined POLY_FIR_SIMD
+  #undef CONVOLVE
+  #if COEF_INTERP > 0
+    #define SIMD_X x
+  #else
+    #define SIMD_X 0
+  #endif
+  #define CONVOLVE j = FIR_LENGTH & ~1, sum = poly_fir_simd(COEF_INTERP)(&coef( \
+      p->shared->poly_fir_coefs, COEF_INTERP, FIR_LENGTH, phase, COEF_INTERP, 0), \
+      in, j, SIMD_X); \
+    if (j < FIR_LENGTH) _
+#endif
 
 static void FUNCTION(stage_t * p, fifo_t * output_fifo)
 {
@@ -80,6 +92,7 @@ static void FUNCTION(stage_t * p, fifo_t * output_fifo)
 }
 
 #undef _
+#undef SIMD_X
 #undef a
 #undef b
 #undef c
@@ -19,6 +19,12 @@
 /* Input must be followed by LEN-1 samples. */
 
 #define _ sum += (coef(p->shared->poly_fir_coefs, 0, FIR_LENGTH, divided.rem, 0, j)) *at[j], ++j;
+#if defined POLY_FIR_SIMD
+  #undef CONVOLVE
+  #define CONVOLVE j = FIR_LENGTH & ~1, sum = poly_fir_simd(0)(&coef( \
+      p->shared->poly_fir_coefs, 0, FIR_LENGTH, divided.rem, 0, 0), at, j, 0); \
+    if (j < FIR_LENGTH) _
+#endif
 
 static void FUNCTION(stage_t * p, fifo_t * output_fifo)
 {
@@ -9,6 +9,10 @@
 
 #include "sox_i.h"
 #include "g711.h"
+#include <string.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
 
 typedef sox_uint16_t sox_uint14_t;
 typedef sox_uint16_t sox_uint13_t;
@@ -63,21 +67,40 @@ int lsx_rawstart(sox_format_t * ft, sox_bool default_rate,
     ft->signal.length =
         div_bits(lsx_filelength(ft), ft->encoding.bits_per_sample);
 
+  /* Encodings that read_chunked or sox_read_sdw_samples can decode from a
+   * mapping; other encodings, and other handlers, read through stdio */
+  if (ft->mode == 'r' && ft->seekable && ft->io_type == lsx_io_file && (
+      (ft->encoding.encoding == SOX_ENCODING_SIGN2 &&
+       (ft->encoding.bits_per_sample == 16 ||
+        ft->encoding.bits_per_sample == 24 ||
+        ft->encoding.bits_per_sample == 32)) ||
+      (ft->encoding.encoding == SOX_ENCODING_FLOAT &&
+       (ft->encoding.bits_per_sample == 32 ||
+        ft->encoding.bits_per_sample == 64))))
+    lsx_map_input(ft);
+
   return SOX_SUCCESS;
 }
 
+/* Samples are converted via a fixed-size scratch buffer on the stack, in as
+ * many chunks as needed, so that reading & writing never allocate memory. */
+#define RAW_CHUNK 2048
+
 #define READ_SAMPLES_FUNC(type, size, sign, ctype, uctype, cast) \
   static size_t sox_read_ ## sign ## type ## _samples( \
       sox_format_t * ft, sox_sample_t *buf, size_t len) \
   { \
-    size_t n, nread; \
+    size_t n, i, chunk, nread = 0; \
     SOX_SAMPLE_LOCALS; \
-    ctype *data = lsx_malloc(sizeof(ctype) * len); \
+    ctype data[RAW_CHUNK]; \
     LSX_USE_VAR(sox_macro_temp_sample), LSX_USE_VAR(sox_macro_temp_double); \
-    nread = lsx_read_ ## type ## _buf(ft, (uctype *)data, len); \
-    for (n = 0; n < nread; n++) \
-      *buf++ = cast(data[n], ft->clips); \
-    free(data); \
+    do { \
+      chunk = min(len - nread, RAW_CHUNK); \
+      n = lsx_read_ ## type ## _buf(ft, (uctype *)data, chunk); \
+      for (i = 0; i < n; i++) \
+        *buf++ = cast(data[i], ft->clips); \
+      nread += n; \
+    } while (n == chunk && nread < len); \
     return nread; \
   }
 
@@ -86,26 +109,24 @@ READ_SAMPLES_FUNC(b, 1, s, int8_t, uint8_t, SOX_SIGNED_8BIT_TO_SAMPLE)
 READ_SAMPLES_FUNC(b, 1, ulaw, uint8_t, uint8_t, SOX_ULAW_BYTE_TO_SAMPLE)
 READ_SAMPLES_FUNC(b, 1, alaw, uint8_t, uint8_t, SOX_ALAW_BYTE_TO_SAMPLE)
 READ_SAMPLES_FUNC(w, 2, u, uint16_t, uint16_t, SOX_UNSIGNED_16BIT_TO_SAMPLE)
-READ_SAMPLES_FUNC(w, 2, s, int16_t, uint16_t, SOX_SIGNED_16BIT_TO_SAMPLE)
 READ_SAMPLES_FUNC(3, 3, u, sox_uint24_t, sox_uint24_t, SOX_UNSIGNED_24BIT_TO_SAMPLE)
-READ_SAMPLES_FUNC(3, 3, s, sox_int24_t, sox_uint24_t, SOX_SIGNED_24BIT_TO_SAMPLE)
 READ_SAMPLES_FUNC(dw, 4, u, uint32_t, uint32_t, SOX_UNSIGNED_32BIT_TO_SAMPLE)
-READ_SAMPLES_FUNC(dw, 4, s, int32_t, uint32_t, SOX_SIGNED_32BIT_TO_SAMPLE)
-READ_SAMPLES_FUNC(f, sizeof(float), su, float, float, SOX_FLOAT_32BIT_TO_SAMPLE)
-READ_SAMPLES_FUNC(df, sizeof(double), su, double, double, SOX_FLOAT_64BIT_TO_SAMPLE)
 
 #define WRITE_SAMPLES_FUNC(type, size, sign, ctype, uctype, cast) \
   static size_t sox_write_ ## sign ## type ## _samples( \
       sox_format_t * ft, sox_sample_t const * buf, size_t len) \
   { \
+    size_t n, i, chunk, nwritten = 0; \
     SOX_SAMPLE_LOCALS; \
-    size_t n, nwritten; \
-    ctype *data = lsx_malloc(sizeof(ctype) * len); \
+    ctype data[RAW_CHUNK]; \
     LSX_USE_VAR(sox_macro_temp_sample), LSX_USE_VAR(sox_macro_temp_double); \
-    for (n = 0; n < len; n++) \
-      data[n] = cast(buf[n], ft->clips); \
-    nwritten = lsx_write_ ## type ## _buf(ft, (uctype *)data, len); \
-    free(data); \
+    do { \
+      chunk = min(len - nwritten, RAW_CHUNK); \
+      for (i = 0; i < chunk; i++) \
+        data[i] = cast(*buf++, ft->clips); \
+      n = lsx_write_ ## type ## _buf(ft, (uctype *)data, chunk); \
+      nwritten += n; \
+    } while (n == chunk && nwritten < len); \
     return nwritten; \
   }
 
@@ -115,13 +136,380 @@ WRITE_SAMPLES_FUNC(b, 1, s, int8_t, uint8_t, SOX_SAMPLE_TO_SIGNED_8BIT)
 WRITE_SAMPLES_FUNC(b, 1, ulaw, uint8_t, uint8_t, SOX_SAMPLE_TO_ULAW_BYTE) 
 WRITE_SAMPLES_FUNC(b, 1, alaw, uint8_t, uint8_t, SOX_SAMPLE_TO_ALAW_BYTE)
 WRITE_SAMPLES_FUNC(w, 2, u, uint16_t, uint16_t, SOX_SAMPLE_TO_UNSIGNED_16BIT) 
-WRITE_SAMPLES_FUNC(w, 2, s, int16_t, uint16_t, SOX_SAMPLE_TO_SIGNED_16BIT)
 WRITE_SAMPLES_FUNC(3, 3, u, sox_uint24_t, sox_uint24_t, SOX_SAMPLE_TO_UNSIGNED_24BIT) 
-WRITE_SAMPLES_FUNC(3, 3, s, sox_int24_t, sox_uint24_t, SOX_SAMPLE_TO_SIGNED_24BIT)
 WRITE_SAMPLES_FUNC(dw, 4, u, uint32_t, uint32_t, SOX_SAMPLE_TO_UNSIGNED_32BIT) 
-WRITE_SAMPLES_FUNC(dw, 4, s, int32_t, uint32_t, SOX_SAMPLE_TO_SIGNED_32BIT)
-WRITE_SAMPLES_FUNC(f, sizeof(float), su, float, float, SOX_SAMPLE_TO_FLOAT_32BIT) 
-WRITE_SAMPLES_FUNC(df, sizeof (double), su, double, double, SOX_SAMPLE_TO_FLOAT_64BIT)
+
+/* The commonest encodings (signed 16, 24 & 32-bit, and float) have their own
+ * readers & writers, which read or write the file's bytes directly and
+ * convert them, byte-swapping as needed, in one pass; where SSE2 is
+ * available, the conversions are done four (integer) or two (floating-
+ * point) samples at a time.  Each _sse2 function returns the number of
+ * samples done; the rest are left for the following scalar loop. */
+
+#ifdef __SSE2__
+#define ld(p)    _mm_loadu_si128((__m128i const *)(p))
+#define st(p, x) _mm_storeu_si128((__m128i *)(p), x)
+
+static __m128i swap16_sse2(__m128i x)
+{
+  return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static __m128i swap32_sse2(__m128i x)
+{
+  return swap16_sse2(_mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16)));
+}
+
+static size_t s16_to_samples_sse2(sox_sample_t * dest, int16_t const * src,
+    size_t n, sox_bool swap)
+{
+  size_t i;
+  __m128i const zero = _mm_setzero_si128();
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m128i x = ld(src + i);
+    if (swap)
+      x = swap16_sse2(x);
+    st(dest + i, _mm_unpacklo_epi16(zero, x));
+    st(dest + i + 4, _mm_unpackhi_epi16(zero, x));
+  }
+  return i;
+}
+
+/* Rounds as SOX_SAMPLE_TO_SIGNED_16BIT; clipped lanes are counted by mask */
+static __m128i samples_to_s32x4_16(__m128i x, sox_uint64_t * clips)
+{
+  __m128i const max = _mm_set1_epi32(SOX_SAMPLE_MAX - (1 << 15));
+  __m128i clip = _mm_cmpgt_epi32(x, max);
+  __m128i y = _mm_srai_epi32(_mm_add_epi32(x, _mm_set1_epi32(1 << 15)), 16);
+  int mask = _mm_movemask_ps(_mm_castsi128_ps(clip));
+  if (mask) {
+    *clips += (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3);
+    y = _mm_or_si128(_mm_andnot_si128(clip, y),
+        _mm_and_si128(clip, _mm_set1_epi32(SOX_INT_MAX(16))));
+  }
+  return y;
+}
+
+static size_t samples_to_s16_sse2(int16_t * dest, sox_sample_t const * src,
+    size_t n, sox_bool swap, sox_uint64_t * clips)
+{
+  size_t i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m128i x = _mm_packs_epi32(samples_to_s32x4_16(ld(src + i), clips),
+        samples_to_s32x4_16(ld(src + i + 4), clips));
+    st(dest + i, swap? swap16_sse2(x) : x);
+  }
+  return i;
+}
+
+static size_t swap32_sse2_n(uint32_t * dest, uint32_t const * src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 4 <= n; i += 4)
+    st(dest + i, swap32_sse2(ld(src + i)));
+  return i;
+}
+
+/* Rounds & clips as SOX_FLOAT_64BIT_TO_SAMPLE */
+static __m128i doubles_to_samples_sse2(__m128d x, sox_uint64_t * clips)
+{
+  __m128d const lo = _mm_set1_pd(SOX_SAMPLE_MIN), hi = _mm_set1_pd(SOX_SAMPLE_MAX);
+  __m128d const sign = _mm_set1_pd(-0.);
+  __m128d d = _mm_mul_pd(x, _mm_set1_pd(SOX_SAMPLE_MAX + 1.0));
+  int mask = _mm_movemask_pd(_mm_or_pd(
+      _mm_cmple_pd(d, _mm_set1_pd(SOX_SAMPLE_MIN - 0.5)),
+      _mm_cmpgt_pd(d, _mm_set1_pd(SOX_SAMPLE_MAX + 1.0))));
+  *clips += (mask & 1) + (mask >> 1);
+  d = _mm_add_pd(d, _mm_or_pd(_mm_and_pd(d, sign), _mm_set1_pd(.5)));
+  return _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(d, lo), hi));
+}
+
+static size_t floats_to_samples_sse2(sox_sample_t * dest, float const * src,
+    size_t n, sox_bool swap, sox_uint64_t * clips)
+{
+  size_t i;
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i x = ld(src + i);
+    __m128 f = _mm_castsi128_ps(swap? swap32_sse2(x) : x);
+    __m128i a = doubles_to_samples_sse2(_mm_cvtps_pd(f), clips);
+    __m128i b = doubles_to_samples_sse2(_mm_cvtps_pd(_mm_movehl_ps(f, f)), clips);
+    st(dest + i, _mm_unpacklo_epi64(a, b));
+  }
+  return i;
+}
+
+static size_t samples_to_floats_sse2(float * dest, sox_sample_t const * src,
+    size_t n, sox_bool swap)
+{
+  size_t i;
+  __m128d const scale = _mm_set1_pd(1.0 / (SOX_SAMPLE_MAX + 1.0));
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i x = ld(src + i);
+    __m128 a = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(x), scale));
+    __m128 b = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), scale));
+    x = _mm_castps_si128(_mm_movelh_ps(a, b));
+    st(dest + i, swap? swap32_sse2(x) : x);
+  }
+  return i;
+}
+
+static size_t doubles_to_samples_sse2_n(sox_sample_t * dest, double const * src,
+    size_t n, sox_bool swap, sox_uint64_t * clips)
+{
+  size_t i;
+  for (i = 0; i + 2 <= n; i += 2) {
+    __m128i x = ld(src + i);
+    if (swap)
+      x = swap32_sse2(_mm_shuffle_epi32(x, 0xb1));
+    _mm_storel_epi64((__m128i *)(dest + i),
+        doubles_to_samples_sse2(_mm_castsi128_pd(x), clips));
+  }
+  return i;
+}
+
+static size_t samples_to_doubles_sse2(double * dest, sox_sample_t const * src,
+    size_t n, sox_bool swap)
+{
+  size_t i;
+  __m128d const scale = _mm_set1_pd(1.0 / (SOX_SAMPLE_MAX + 1.0));
+  for (i = 0; i + 2 <= n; i += 2) {
+    __m128i x = _mm_castpd_si128(_mm_mul_pd(
+        _mm_cvtepi32_pd(_mm_loadl_epi64((__m128i const *)(src + i))), scale));
+    st(dest + i, swap? swap32_sse2(_mm_shuffle_epi32(x, 0xb1)) : x);
+  }
+  return i;
+}
+
+#undef ld
+#undef st
+#else
+#define s16_to_samples_sse2(dest, src, n, swap) 0
+#define samples_to_s16_sse2(dest, src, n, swap, clips) 0
+#define swap32_sse2_n(dest, src, n) 0
+#define floats_to_samples_sse2(dest, src, n, swap, clips) 0
+#define samples_to_floats_sse2(dest, src, n, swap) 0
+#define doubles_to_samples_sse2_n(dest, src, n, swap, clips) 0
+#define samples_to_doubles_sse2(dest, src, n, swap) 0
+#endif
+
+static float swapf(float f)
+{
+  union {uint32_t dw; float f;} u;
+  u.f = f;
+  u.dw = lsx_swapdw(u.dw);
+  return u.f;
+}
+
+static double swapdf(double d)
+{
+  union {uint32_t dw[2]; double d;} u;
+  uint32_t t;
+  u.d = d;
+  t = lsx_swapdw(u.dw[0]), u.dw[0] = lsx_swapdw(u.dw[1]), u.dw[1] = t;
+  return u.d;
+}
+
+typedef void (raw_decode_fn)(sox_format_t * ft, sox_sample_t * dest,
+    void const * data, size_t n);
+typedef void (raw_encode_fn)(sox_format_t * ft, void * data,
+    sox_sample_t const * src, size_t n);
+
+/* Reads up to len samples, of the given byte size, and decodes them to buf:
+ * from the input file's memory map if there is one (copied in chunks to a
+ * buffer on the stack if misaligned for the decoder's loads, e.g. after an
+ * odd-length header), otherwise (or for any remainder) read in chunks to the
+ * buffer; returns samples read. */
+static size_t read_chunked(sox_format_t * ft, sox_sample_t * buf, size_t len,
+    size_t size, raw_decode_fn * decode)
+{
+  double data[RAW_CHUNK]; /* Sized & aligned for the largest type */
+  size_t n = len, chunk, nread = 0;
+  char const * mapped = lsx_read_mapped(ft, size, &n);
+
+  if (mapped && size != 3 && (size_t)mapped % size)
+    for (; nread < n; nread += chunk) {
+      chunk = min(n - nread, RAW_CHUNK);
+      memcpy(data, mapped + nread * size, chunk * size);
+      decode(ft, buf + nread, data, chunk);
+    }
+  else if (mapped)
+    decode(ft, buf, mapped, nread = n);
+  if (mapped && nread == len)
+    return nread;
+  do {
+    chunk = min(len - nread, RAW_CHUNK);
+    n = lsx_readbuf(ft, data, chunk * size) / size;
+    decode(ft, buf + nread, data, n);
+    nread += n;
+  } while (n == chunk && nread < len);
+  return nread;
+}
+
+static size_t write_chunked(sox_format_t * ft, sox_sample_t const * buf,
+    size_t len, size_t size, raw_encode_fn * encode)
+{
+  double data[RAW_CHUNK];
+  size_t n, chunk, nwritten = 0;
+
+  do {
+    chunk = min(len - nwritten, RAW_CHUNK);
+    encode(ft, data, buf + nwritten, chunk);
+    n = lsx_writebuf(ft, data, chunk * size) / size;
+    nwritten += n;
+  } while (n == chunk && nwritten < len);
+  return nwritten;
+}
+
+static void decode_s16(sox_format_t * ft, sox_sample_t * dest, void const * data, size_t n)
+{
+  int16_t const * src = data;
+  sox_bool swap = ft->encoding.reverse_bytes;
+  size_t i = s16_to_samples_sse2(dest, src, n, swap);
+
+  for (; i < n; ++i)
+    dest[i] = SOX_SIGNED_16BIT_TO_SAMPLE(
+        swap? (int16_t)lsx_swapw((uint16_t)src[i]) : src[i], ft->clips);
+}
+
+static void encode_s16(sox_format_t * ft, void * data, sox_sample_t const * src, size_t n)
+{
+  int16_t * dest = data;
+  sox_bool swap = ft->encoding.reverse_bytes;
+  size_t i = samples_to_s16_sse2(dest, src, n, swap, &ft->clips);
+  SOX_SAMPLE_LOCALS;
+
+  for (; i < n; ++i) {
+    dest[i] = SOX_SAMPLE_TO_SIGNED_16BIT(src[i], ft->clips);
+    if (swap)
+      dest[i] = (int16_t)lsx_swapw((uint16_t)dest[i]);
+  }
+}
+
+static void decode_s24(sox_format_t * ft, sox_sample_t * dest, void const * data, size_t n)
+{
+  uint8_t const * p = data;
+  size_t i;
+
+  if (ft->encoding.reverse_bytes != MACHINE_IS_BIGENDIAN)
+    for (i = 0; i < n; ++i, p += 3)
+      dest[i] = (sox_sample_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8);
+  else for (i = 0; i < n; ++i, p += 3)
+    dest[i] = (sox_sample_t)((uint32_t)p[2] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 8);
+}
+
+static void encode_s24(sox_format_t * ft, void * data, sox_sample_t const * src, size_t n)
+{
+  uint8_t * p = data;
+  sox_bool big = ft->encoding.reverse_bytes != MACHINE_IS_BIGENDIAN;
+  size_t i;
+  SOX_SAMPLE_LOCALS;
+
+  for (i = 0; i < n; ++i, p += 3) {
+    uint32_t v = (uint32_t)SOX_SAMPLE_TO_SIGNED_24BIT(src[i], ft->clips);
+    if (big)
+      p[0] = v >> 16 & 0xff, p[1] = v >> 8 & 0xff, p[2] = v & 0xff;
+    else p[2] = v >> 16 & 0xff, p[1] = v >> 8 & 0xff, p[0] = v & 0xff;
+  }
+}
+
+static void encode_swapped_s32(sox_format_t * ft UNUSED, void * data, sox_sample_t const * src, size_t n)
+{
+  uint32_t * dest = data;
+  size_t i = swap32_sse2_n(dest, (uint32_t const *)src, n);
+
+  for (; i < n; ++i)
+    dest[i] = lsx_swapdw((uint32_t)src[i]);
+}
+
+static void decode_f32(sox_format_t * ft, sox_sample_t * dest, void const * data, size_t n)
+{
+  float const * src = data;
+  sox_bool swap = ft->encoding.reverse_bytes;
+  size_t i = floats_to_samples_sse2(dest, src, n, swap, &ft->clips);
+  SOX_SAMPLE_LOCALS;
+
+  for (; i < n; ++i)
+    dest[i] = SOX_FLOAT_32BIT_TO_SAMPLE(swap? swapf(src[i]) : src[i], ft->clips);
+}
+
+static void encode_f32(sox_format_t * ft, void * data, sox_sample_t const * src, size_t n)
+{
+  float * dest = data;
+  sox_bool swap = ft->encoding.reverse_bytes;
+  size_t i = samples_to_floats_sse2(dest, src, n, swap);
+
+  for (; i < n; ++i) {
+    dest[i] = SOX_SAMPLE_TO_FLOAT_32BIT(src[i], ft->clips);
+    if (swap)
+      dest[i] = swapf(dest[i]);
+  }
+}
+
+static void decode_f64(sox_format_t * ft, sox_sample_t * dest, void const * data, size_t n)
+{
+  double const * src = data;
+  sox_bool swap = ft->encoding.reverse_bytes;
+  size_t i = doubles_to_samples_sse2_n(dest, src, n, swap, &ft->clips);
+  SOX_SAMPLE_LOCALS;
+
+  for (; i < n; ++i)
+    dest[i] = SOX_FLOAT_64BIT_TO_SAMPLE(swap? swapdf(src[i]) : src[i], ft->clips);
+}
+
+static void encode_f64(sox_format_t * ft, void * data, sox_sample_t const * src, size_t n)
+{
+  double * dest = data;
+  sox_bool swap = ft->encoding.reverse_bytes;
+  size_t i = samples_to_doubles_sse2(dest, src, n, swap);
+
+  for (; i < n; ++i) {
+    dest[i] = SOX_SAMPLE_TO_FLOAT_64BIT(src[i], ft->clips);
+    if (swap)
+      dest[i] = swapdf(dest[i]);
+  }
+}
+
+static size_t sox_read_sw_samples(sox_format_t * ft, sox_sample_t * buf, size_t len)
+  {return read_chunked(ft, buf, len, 2, decode_s16);}
+static size_t sox_write_sw_samples(sox_format_t * ft, sox_sample_t const * buf, size_t len)
+  {return write_chunked(ft, buf, len, 2, encode_s16);}
+static size_t sox_read_s3_samples(sox_format_t * ft, sox_sample_t * buf, size_t len)
+  {return read_chunked(ft, buf, len, 3, decode_s24);}
+static size_t sox_write_s3_samples(sox_format_t * ft, sox_sample_t const * buf, size_t len)
+  {return write_chunked(ft, buf, len, 3, encode_s24);}
+static size_t sox_read_suf_samples(sox_format_t * ft, sox_sample_t * buf, size_t len)
+  {return read_chunked(ft, buf, len, sizeof(float), decode_f32);}
+static size_t sox_write_suf_samples(sox_format_t * ft, sox_sample_t const * buf, size_t len)
+  {return write_chunked(ft, buf, len, sizeof(float), encode_f32);}
+static size_t sox_read_sudf_samples(sox_format_t * ft, sox_sample_t * buf, size_t len)
+  {return read_chunked(ft, buf, len, sizeof(double), decode_f64);}
+static size_t sox_write_sudf_samples(sox_format_t * ft, sox_sample_t const * buf, size_t len)
+  {return write_chunked(ft, buf, len, sizeof(double), encode_f64);}
+
+/* 32-bit samples need no conversion, so are read straight into buf, and
+ * written straight from it unless byte-swapped */
+static size_t sox_read_sdw_samples(sox_format_t * ft, sox_sample_t * buf, size_t len)
+{
+  size_t i, n = len;
+  void const * mapped = lsx_read_mapped(ft, 4, &n);
+
+  if (mapped)
+    memcpy(buf, mapped, n * 4);
+  if (n < len)
+    n += lsx_readbuf(ft, buf + n, (len - n) * 4) / 4;
+
+  if (ft->encoding.reverse_bytes)
+    for (i = swap32_sse2_n((uint32_t *)buf, (uint32_t *)buf, n); i < n; ++i)
+      buf[i] = (sox_sample_t)lsx_swapdw((uint32_t)buf[i]);
+  return n;
+}
+
+static size_t sox_write_sdw_samples(sox_format_t * ft, sox_sample_t const * buf, size_t len)
+{
+  if (ft->encoding.reverse_bytes)
+    return write_chunked(ft, buf, len, 4, encode_swapped_s32);
+  return lsx_writebuf(ft, buf, len * 4) / 4;
+}
 
 #define GET_FORMAT(type) \
 static ft_##type##_fn * type##_fn(sox_format_t * ft) { \
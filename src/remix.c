@@ -162,16 +162,21 @@ static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
     sox_sample_t * obuf, size_t * isamp, size_t * osamp)
 {
   priv_t * p = (priv_t *)effp->priv;
-  unsigned i, j, len;
+  unsigned i, j, k, len;
+  /* Channel by channel, whether planar or interleaved (e.g. when fused) */
+  size_t istride = effp->planar? lsx_plane_size(effp->in_signal.channels) : 1;
+  size_t ostride = effp->planar? lsx_plane_size(effp->out_signal.channels) : 1;
+  size_t istep = effp->planar? 1 : effp->in_signal.channels;
+  size_t ostep = effp->planar? 1 : effp->out_signal.channels;
   len =  min(*isamp / effp->in_signal.channels, *osamp / effp->out_signal.channels);
   *isamp = len * effp->in_signal.channels;
   *osamp = len * effp->out_signal.channels;
 
-  for (; len--; ibuf += effp->in_signal.channels) for (j = 0; j < effp->out_signal.channels; j++) {
+  for (j = 0; j < effp->out_signal.channels; j++, obuf += ostride) for (k = 0; k < len; k++) {
     double out = 0;
     for (i = 0; i < p->out_specs[j].num_in_channels; i++)
-      out += ibuf[p->out_specs[j].in_specs[i].channel_num] * p->out_specs[j].in_specs[i].multiplier;
-    *obuf++ = SOX_ROUND_CLIP_COUNT(out, effp->clips);
+      out += ibuf[p->out_specs[j].in_specs[i].channel_num * istride + k * istep] * p->out_specs[j].in_specs[i].multiplier;
+    obuf[k * ostep] = SOX_ROUND_CLIP_COUNT(out, effp->clips);
   }
   return SOX_SUCCESS;
 }
@@ -192,7 +197,8 @@ sox_effect_handler_t const * lsx_remix_effect_fn(void)
 {
   static sox_effect_handler_t handler = {
     "remix", "[-m|-a] [-p] <0|in-chan[v|p|i volume]{,in-chan[v|p|i volume]}>",
-    SOX_EFF_MCHAN | SOX_EFF_CHAN | SOX_EFF_GAIN | SOX_EFF_PREC,
+    SOX_EFF_MCHAN | SOX_EFF_CHAN | SOX_EFF_GAIN | SOX_EFF_PREC | SOX_EFF_PLANAR |
+    SOX_EFF_FUSE,
     create, start, flow, NULL, NULL, closedown, sizeof(priv_t)
   };
   return &handler;
@@ -19,34 +19,35 @@
 
 #include "sox_i.h"
 #include "fifo.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define lsx_zalloc(var, n) var = lsx_calloc(n, sizeof(*var))
-#define filter_advance(p) if (--(p)->ptr < (p)->buffer) (p)->ptr += (p)->size
 #define filter_delete(p) free((p)->buffer)
-
+#define BLOCK 256 /* Most samples taken through the filters at a time */
+
+/* Each step, a filter reads the sample at ptr, written `size' steps before,
+ * then writes a new one there; ptr moves through the buffer, wrapping.  So,
+ * in a block of steps no longer than any filter's size, all the samples
+ * read are ones written before the block: a filter's reads, and its writes,
+ * can each be done for the whole block at once; only the comb filters'
+ * damping is a recursion to be taken step by step. */
 typedef struct {
   size_t  size;
   float   * buffer, * ptr;
   float   store;
 } filter_t;
 
-static float comb_process(filter_t * p,  /* gcc -O2 will inline this */
-    float const * input, float const * feedback, float const * hf_damping)
+static size_t filter_run(filter_t const * p, size_t n) /* Steps to the wrap */
 {
-  float output = *p->ptr;
-  p->store = output + (p->store - output) * *hf_damping;
-  *p->ptr = *input + p->store * *feedback;
-  filter_advance(p);
-  return output;
+  return min(n, (size_t)(p->buffer + p->size - p->ptr));
 }
 
-static float allpass_process(filter_t * p,  /* gcc -O2 will inline this */
-    float const * input)
+static void filter_advance(filter_t * p, size_t n)
 {
-  float output = *p->ptr;
-  *p->ptr = *input + output * .5;
-  filter_advance(p);
-  return output - *input;
+  if ((p->ptr += n) == p->buffer + p->size)
+    p->ptr = p->buffer;
 }
 
 static const size_t /* Filter delay lengths in samples (44100Hz sample-rate) */
@@ -55,56 +56,175 @@ static const size_t /* Filter delay lengths in samples (44100Hz sample-rate) */
 #define stereo_adjust 12
 
 typedef struct {
+  size_t   num_combs, num_allpasses;
   filter_t comb   [array_length(comb_lengths)];
   filter_t allpass[array_length(allpass_lengths)];
+  size_t   block;   /* Steps per block; no more than any filter's size */
 } filter_array_t;
 
 static void filter_array_create(filter_array_t * p, double rate,
-    double scale, double offset)
+    double scale, double offset, sox_bool low_cpu)
 {
   size_t i;
   double r = rate * (1 / 44100.); /* Compensate for actual sample-rate */
 
+  p->block = BLOCK;
   for (i = 0; i < array_length(comb_lengths); ++i, offset = -offset)
-  {
-    filter_t * pcomb = &p->comb[i];
+  if (!low_cpu || !(i & 1)) { /* Low CPU: every other comb... */
+    filter_t * pcomb = &p->comb[p->num_combs++];
     pcomb->size = (size_t)(scale * r * (comb_lengths[i] + stereo_adjust * offset) + .5);
     pcomb->ptr = lsx_zalloc(pcomb->buffer, pcomb->size);
+    p->block = min(p->block, pcomb->size);
   }
   for (i = 0; i < array_length(allpass_lengths); ++i, offset = -offset)
-  {
-    filter_t * pallpass = &p->allpass[i];
+  if (!low_cpu || (i & 1)) { /* ...and the longer of each pair of allpasses */
+    filter_t * pallpass = &p->allpass[p->num_allpasses++];
     pallpass->size = (size_t)(r * (allpass_lengths[i] + stereo_adjust * offset) + .5);
     pallpass->ptr = lsx_zalloc(pallpass->buffer, pallpass->size);
+    p->block = min(p->block, pallpass->size);
+  }
+  p->block = max(p->block, 1);
+}
+
+#ifdef __SSE2__
+/* Feed 4 combs' outputs o (one per lane) back with the damping recursion */
+#define COMB4(st, o, x) (st = _mm_add_ps(o, _mm_mul_ps(_mm_sub_ps(st, o), \
+    damping)), o = _mm_add_ps(x, _mm_mul_ps(st, feedback)))
+
+/* Each comb's next 4 steps: its samples, transposed to a step per vector */
+static void combs4_sse2(float * const * ptr, float * store, size_t nq,
+    float const * input, float hf_damping, float fb, size_t n)
+{
+  __m128 damping = _mm_set1_ps(hf_damping), feedback = _mm_set1_ps(fb);
+  __m128 sa = _mm_loadu_ps(store), sb = _mm_loadu_ps(store + 4 * (nq - 1));
+  size_t j;
+
+  for (j = 0; j < n; j += 4) {
+    __m128 x = _mm_loadu_ps(input + j), x0, x1, x2, x3;
+    __m128 a0 = _mm_loadu_ps(ptr[0] + j), a1 = _mm_loadu_ps(ptr[1] + j);
+    __m128 a2 = _mm_loadu_ps(ptr[2] + j), a3 = _mm_loadu_ps(ptr[3] + j);
+    x0 = _mm_shuffle_ps(x, x, 0x00), x1 = _mm_shuffle_ps(x, x, 0x55);
+    x2 = _mm_shuffle_ps(x, x, 0xaa), x3 = _mm_shuffle_ps(x, x, 0xff);
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    if (nq == 2) { /* Interleave a second set of combs' recursions */
+      __m128 b0 = _mm_loadu_ps(ptr[4] + j), b1 = _mm_loadu_ps(ptr[5] + j);
+      __m128 b2 = _mm_loadu_ps(ptr[6] + j), b3 = _mm_loadu_ps(ptr[7] + j);
+      _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+      COMB4(sa, a0, x0), COMB4(sb, b0, x0), COMB4(sa, a1, x1);
+      COMB4(sb, b1, x1), COMB4(sa, a2, x2), COMB4(sb, b2, x2);
+      COMB4(sa, a3, x3), COMB4(sb, b3, x3);
+      _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+      _mm_storeu_ps(ptr[4] + j, b0), _mm_storeu_ps(ptr[5] + j, b1);
+      _mm_storeu_ps(ptr[6] + j, b2), _mm_storeu_ps(ptr[7] + j, b3);
+    }
+    else COMB4(sa, a0, x0), COMB4(sa, a1, x1), COMB4(sa, a2, x2),
+      COMB4(sa, a3, x3);
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _mm_storeu_ps(ptr[0] + j, a0), _mm_storeu_ps(ptr[1] + j, a1);
+    _mm_storeu_ps(ptr[2] + j, a2), _mm_storeu_ps(ptr[3] + j, a3);
   }
+  _mm_storeu_ps(store, sa);
+  if (nq == 2)
+    _mm_storeu_ps(store + 4, sb);
 }
+#endif
 
+/* The same arithmetic, in the same order for each sample, as taking one
+ * sample at a time through the combs (last first, summing their outputs),
+ * then through the allpasses (last first).  With SSE2, the element-wise
+ * arithmetic is done 4 samples at a time, and the combs' recursions (and
+ * those of the next 4 combs too) 4 combs at a time. */
 static void filter_array_process(filter_array_t * p,
     size_t length, float const * input, float * output,
     float const * feedback, float const * hf_damping, float const * gain)
 {
-  while (length--) {
-    float out = 0, in = *input++;
-
-    size_t i = array_length(comb_lengths) - 1;
-    do out += comb_process(p->comb + i, &in, feedback, hf_damping);
-    while (i--);
-
-    i = array_length(allpass_lengths) - 1;
-    do out = allpass_process(p->allpass + i, &out);
-    while (i--);
-
-    *output++ = out * *gain;
+  float out[BLOCK], store[array_length(comb_lengths)];
+  size_t i, j, k, n, run;
+
+  for (i = 0; i < p->num_combs; ++i)
+    store[i] = p->comb[i].store;
+  for (; length; length -= n, input += n, output += n) {
+    n = min(length, p->block);
+    for (i = 0; i < p->num_combs; ++i) /* Let no comb wrap in the block */
+      n = filter_run(&p->comb[i], n);
+
+    memset(out, 0, n * sizeof(*out));
+    i = p->num_combs - 1;
+    do {
+      float const * ptr = p->comb[i].ptr;
+      j = 0;
+#ifdef __SSE2__
+      for (; j + 4 <= n; j += 4) _mm_storeu_ps(out + j,
+          _mm_add_ps(_mm_loadu_ps(out + j), _mm_loadu_ps(ptr + j)));
+#endif
+      for (; j < n; ++j) out[j] += ptr[j];
+    } while (i--);
+
+    for (i = 0; i < p->num_combs; i += 8) {
+      size_t c, nc = min(p->num_combs - i, 8);
+      float * ptr[8];
+      for (c = 0; c < nc; ++c)
+        ptr[c] = p->comb[i + c].ptr;
+      j = 0;
+#ifdef __SSE2__
+      combs4_sse2(ptr, store + i, nc / 4, input, *hf_damping, *feedback,
+          j = n & ~(size_t)3);
+#endif
+      for (; j < n; ++j) for (c = 0; c < nc; ++c) {
+        float comb_out = ptr[c][j];
+        store[i + c] = comb_out + (store[i + c] - comb_out) * *hf_damping;
+        ptr[c][j] = input[j] + store[i + c] * *feedback;
+      }
+    }
+    for (i = 0; i < p->num_combs; ++i)
+      filter_advance(&p->comb[i], n);
+
+    i = p->num_allpasses - 1;
+    do for (k = 0; k < n; k += run) {
+      filter_t * pallpass = &p->allpass[i];
+      float * ptr = pallpass->ptr, * o = out + k;
+      run = filter_run(pallpass, n - k);
+      j = 0;
+#ifdef __SSE2__
+      for (; j + 4 <= run; j += 4) { /* o + ptr * .5 in double, as below */
+        __m128 a = _mm_loadu_ps(ptr + j), x = _mm_loadu_ps(o + j);
+        __m128d half = _mm_set1_pd(.5);
+        __m128d lo = _mm_add_pd(_mm_cvtps_pd(x),
+            _mm_mul_pd(_mm_cvtps_pd(a), half));
+        __m128d hi = _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)),
+            _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)), half));
+        _mm_storeu_ps(ptr + j,
+            _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+        _mm_storeu_ps(o + j, _mm_sub_ps(a, x));
+      }
+#endif
+      for (; j < run; ++j) {
+        float allpass_out = ptr[j];
+        ptr[j] = o[j] + allpass_out * .5;
+        o[j] = allpass_out - o[j];
+      }
+      filter_advance(pallpass, run);
+    } while (i--);
+
+    j = 0;
+#ifdef __SSE2__
+    for (; j + 4 <= n; j += 4) _mm_storeu_ps(output + j,
+        _mm_mul_ps(_mm_loadu_ps(out + j), _mm_set1_ps(*gain)));
+#endif
+    for (; j < n; ++j)
+      output[j] = out[j] * *gain;
   }
+  for (i = 0; i < p->num_combs; ++i)
+    p->comb[i].store = store[i];
 }
 
 static void filter_array_delete(filter_array_t * p)
 {
   size_t i;
 
-  for (i = 0; i < array_length(allpass_lengths); ++i)
+  for (i = 0; i < p->num_allpasses; ++i)
     filter_delete(&p->allpass[i]);
-  for (i = 0; i < array_length(comb_lengths); ++i)
+  for (i = 0; i < p->num_combs; ++i)
     filter_delete(&p->comb[i]);
 }
 
@@ -124,6 +244,7 @@ static void reverb_create(reverb_t * p, double sample_rate_Hz,
     double hf_damping,     /* % */
     double pre_delay_ms,
     double stereo_depth,
+    sox_bool low_cpu,
     size_t buffer_size,
     float * * out)
 {
@@ -137,10 +258,13 @@ static void reverb_create(reverb_t * p, double sample_rate_Hz,
   p->feedback = 1 - exp((reverberance - b) / (a * b));
   p->hf_damping = hf_damping / 100 * .3 + .2;
   p->gain = dB_to_linear(wet_gain_dB) * .015;
+  if (low_cpu) /* Half the combs, so about half the power; and two fewer
+                 allpasses, each of which gives white noise 7/3 the power */
+    p->gain *= M_SQRT2 * 7 / 3;
   fifo_create(&p->input_fifo, sizeof(float));
   memset(fifo_write(&p->input_fifo, delay, 0), 0, delay * sizeof(float));
   for (i = 0; i <= ceil(depth); ++i) {
-    filter_array_create(p->chan + i, sample_rate_Hz, scale, i * depth);
+    filter_array_create(p->chan + i, sample_rate_Hz, scale, i * depth, low_cpu);
     out[i] = lsx_zalloc(p->out[i], buffer_size);
   }
 }
@@ -168,7 +292,7 @@ static void reverb_delete(reverb_t * p)
 typedef struct {
   double reverberance, hf_damping, pre_delay_ms;
   double stereo_depth, wet_gain_dB, room_scale;
-  sox_bool wet_only;
+  sox_bool wet_only, low_cpu;
 
   size_t ichannels, ochannels;
   struct {
@@ -183,9 +307,12 @@ static int getopts(sox_effect_t * effp, int argc, char **argv)
   p->reverberance = p->hf_damping = 50; /* Set non-zero defaults */
   p->stereo_depth = p->room_scale = 100;
 
-  --argc, ++argv;
-  p->wet_only = argc && (!strcmp(*argv, "-w") || !strcmp(*argv, "--wet-only"))
-    && (--argc, ++argv, sox_true);
+  for (--argc, ++argv; argc && **argv == '-'; --argc, ++argv)
+    if (!strcmp(*argv, "-w") || !strcmp(*argv, "--wet-only"))
+      p->wet_only = sox_true;
+    else if (!strcmp(*argv, "-l") || !strcmp(*argv, "--low-cpu"))
+      p->low_cpu = sox_true;
+    else return lsx_usage(effp);
   do {  /* break-able block */
     NUMERIC_PARAMETER(reverberance, 0, 100)
     NUMERIC_PARAMETER(hf_damping, 0, 100)
@@ -218,7 +345,7 @@ static int start(sox_effect_t * effp)
   for (i = 0; i < p->ichannels; ++i) reverb_create(
     &p->chan[i].reverb, effp->in_signal.rate, p->wet_gain_dB, p->room_scale,
     p->reverberance, p->hf_damping, p->pre_delay_ms, p->stereo_depth,
-    effp->global_info->global_info->bufsiz / p->ochannels, p->chan[i].wet);
+    p->low_cpu, effp->global_info->global_info->bufsiz / p->ochannels, p->chan[i].wet);
 
   if (effp->in_signal.mult)
     *effp->in_signal.mult /= !p->wet_only + 2 * dB_to_linear(max(0,p->wet_gain_dB));
@@ -235,11 +362,24 @@ static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
   *isamp = len * p->ichannels, *osamp = len * p->ochannels;
   for (c = 0; c < p->ichannels; ++c)
     p->chan[c].dry = fifo_write(&p->chan[c].reverb.input_fifo, len, 0);
-  for (i = 0; i < len; ++i) for (c = 0; c < p->ichannels; ++c)
+  if (effp->planar) for (c = 0; c < p->ichannels; ++c)
+    for (i = 0; i < len; ++i) p->chan[c].dry[i] = SOX_SAMPLE_TO_FLOAT_32BIT(
+        ibuf[c * lsx_plane_size(p->ichannels) + i], effp->clips);
+  else for (i = 0; i < len; ++i) for (c = 0; c < p->ichannels; ++c)
     p->chan[c].dry[i] = SOX_SAMPLE_TO_FLOAT_32BIT(*ibuf++, effp->clips);
   for (c = 0; c < p->ichannels; ++c)
     reverb_process(&p->chan[c].reverb, len);
-  if (p->ichannels == 2) for (i = 0; i < len; ++i) for (w = 0; w < 2; ++w) {
+  if (effp->planar) for (w = 0; w < p->ochannels; ++w) {
+    sox_sample_t * o = obuf + w * lsx_plane_size(p->ochannels);
+    for (i = 0; i < len; ++i) {
+      float out = p->ichannels == 2?
+        (1 - p->wet_only) * p->chan[w].dry[i] +
+          .5 * (p->chan[0].wet[w][i] + p->chan[1].wet[w][i]) :
+        (1 - p->wet_only) * p->chan[0].dry[i] + p->chan[0].wet[w][i];
+      o[i] = SOX_FLOAT_32BIT_TO_SAMPLE(out, effp->clips);
+    }
+  }
+  else if (p->ichannels == 2) for (i = 0; i < len; ++i) for (w = 0; w < 2; ++w) {
     float out = (1 - p->wet_only) * p->chan[w].dry[i] +
       .5 * (p->chan[0].wet[w][i] + p->chan[1].wet[w][i]);
     *obuf++ = SOX_FLOAT_32BIT_TO_SAMPLE(out, effp->clips);
@@ -263,7 +403,7 @@ static int stop(sox_effect_t * effp)
 sox_effect_handler_t const *lsx_reverb_effect_fn(void)
 {
   static sox_effect_handler_t handler = {"reverb",
-    "[-w|--wet-only]"
+    "[-w|--wet-only] [-l|--low-cpu]"
     " [reverberance (50%)"
     " [HF-damping (50%)"
     " [room-scale (100%)"
@@ -271,7 +411,7 @@ sox_effect_handler_t const *lsx_reverb_effect_fn(void)
     " [pre-delay (0ms)"
     " [wet-gain (0dB)"
     "]]]]]]",
-    SOX_EFF_MCHAN, getopts, start, flow, NULL, stop, NULL, sizeof(priv_t)
+    SOX_EFF_MCHAN | SOX_EFF_PLANAR, getopts, start, flow, NULL, stop, NULL, sizeof(priv_t)
   };
   return &handler;
 }
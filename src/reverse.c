@@ -7,26 +7,21 @@
  */
 
 /*
- * "reverse" effect, uses a temporary file created by lsx_tmpfile().
+ * "reverse" effect, uses a spill store (see lsx_spill_create()).
  */
 
 #include "sox_i.h"
-#include <string.h>
 
 typedef struct {
-  off_t         pos;
-  FILE          * tmp_file;
+  sox_uint64_t  pos;
+  lsx_spill_t   * spill;
 } priv_t;
 
 static int start(sox_effect_t * effp)
 {
   priv_t * p = (priv_t *)effp->priv;
   p->pos = 0;
-  p->tmp_file = lsx_tmpfile();
-  if (p->tmp_file == NULL) {
-    lsx_fail("can't create temporary file: %s", strerror(errno));
-    return SOX_EOF;
-  }
+  p->spill = lsx_spill_create();
   return SOX_SUCCESS;
 }
 
@@ -34,12 +29,8 @@ static int flow(sox_effect_t * effp, const sox_sample_t * ibuf,
     sox_sample_t * obuf, size_t * isamp, size_t * osamp)
 {
   priv_t * p = (priv_t *)effp->priv;
-  if (fwrite(ibuf, sizeof(*ibuf), *isamp, p->tmp_file) != *isamp) {
-    lsx_fail("error writing temporary file: %s", strerror(errno));
-    return SOX_EOF;
-  }
   (void)obuf, *osamp = 0; /* samples not output until drain */
-  return SOX_SUCCESS;
+  return lsx_spill_write(p->spill, ibuf, *isamp);
 }
 
 static int drain(sox_effect_t * effp, sox_sample_t *obuf, size_t *osamp)
@@ -47,21 +38,11 @@ static int drain(sox_effect_t * effp, sox_sample_t *obuf, size_t *osamp)
   priv_t * p = (priv_t *)effp->priv;
   int i, j;
 
-  if (p->pos == 0) {
-    fflush(p->tmp_file);
-    p->pos = ftello(p->tmp_file);
-    if (p->pos % sizeof(sox_sample_t) != 0) {
-      lsx_fail("temporary file has incorrect size");
-      return SOX_EOF;
-    }
-    p->pos /= sizeof(sox_sample_t);
-  }
-  p->pos -= *osamp = min((off_t)*osamp, p->pos);
-  fseeko(p->tmp_file, (off_t)(p->pos * sizeof(sox_sample_t)), SEEK_SET);
-  if (fread(obuf, sizeof(sox_sample_t), *osamp, p->tmp_file) != *osamp) {
-    lsx_fail("error reading temporary file: %s", strerror(errno));
+  if (p->pos == 0)
+    p->pos = lsx_spill_length(p->spill);
+  p->pos -= *osamp = min(*osamp, p->pos);
+  if (lsx_spill_read(p->spill, p->pos, obuf, *osamp) != SOX_SUCCESS)
     return SOX_EOF;
-  }
   for (i = 0, j = *osamp - 1; i < j; ++i, --j) { /* reverse the samples */
     sox_sample_t temp = obuf[i];
     obuf[i] = obuf[j];
@@ -73,7 +54,7 @@ static int drain(sox_effect_t * effp, sox_sample_t *obuf, size_t *osamp)
 static int stop(sox_effect_t * effp)
 {
   priv_t * p = (priv_t *)effp->priv;
-  fclose(p->tmp_file); /* auto-deleted by lsx_tmpfile */
+  lsx_spill_delete(p->spill);
   return SOX_SUCCESS;
 }
 
@@ -23,6 +23,7 @@
 
 #include "soxconfig.h"
 #include "sox.h"
+#include "soxomp.h"
 #include "util.h"
 
 #include <ctype.h>
@@ -37,6 +38,10 @@
 #include <sys/types.h>
 #include <time.h>
 
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
 #if defined(HAVE_GLOB_H)
   #include <glob.h>
 #endif
@@ -65,6 +70,10 @@
   #include <sys/ioctl.h>
 #endif
 
+#ifdef HAVE_SYS_WAIT_H
+  #include <sys/wait.h>
+#endif
+
 #ifdef HAVE_GETTIMEOFDAY
   #define TIME_FRAC 1e6
 #else
@@ -107,6 +116,7 @@ static enum { sox_single, sox_multiple } output_method = sox_single;
 #define is_parallel(m) (!is_serial(m))
 static sox_bool no_clobber = sox_false, interactive = sox_false;
 static sox_bool uservolume = sox_false;
+static sox_bool float_effects = sox_false;
 typedef enum {RG_off, RG_track, RG_album, RG_default} rg_mode;
 static lsx_enum_item const rg_modes[] = {
   LSX_ENUM_ITEM(RG_,off)
@@ -134,6 +144,7 @@ typedef struct {
   sox_format_t * ft;  /* libSoX file descriptor */
   uint64_t volume_clips;
   rg_mode replay_gain_mode;
+  double given_volume; /* volume, as given, for a deferred display_file_info */
 } file_t;
 
 static file_t * * files = NULL; /* Array tracking input and output files */
@@ -167,6 +178,7 @@ static sox_bool very_first_effchain = sox_true;
      also that it has never been restarted. Only then we may use the
      optimize_trim() hack. */
 static char *effects_filename = NULL;
+static char *batch_filename = NULL;
 static char * play_rate_arg = NULL;
 static char *norm_level = NULL;
 
@@ -179,6 +191,8 @@ static size_t current_input = 0;
 static uint64_t input_wide_samples = 0;
 static uint64_t read_wide_samples = 0;
 static uint64_t output_samples = 0;
+static sox_bool flowing = sox_false; /* In sox_flow_effects */
+static uint64_t info_shown = 0, info_due = 0; /* See update_status */
 static sox_bool input_eof = sox_false;
 static sox_bool output_eof = sox_false;
 static sox_bool user_abort = sox_false;
@@ -244,6 +258,7 @@ static void cleanup(void)
 
   free(play_rate_arg);
   free(effects_filename);
+  free(batch_filename);
   free(norm_level);
 
   sox_quit();
@@ -437,6 +452,27 @@ static void display_file_info(sox_format_t * ft, file_t * f, sox_bool full)
   fprintf(output, "\n");
 }
 
+/* The input's progress is tracked by the thread reading it, but shown by
+ * the one running update_status: with --pipeline or --io-threads, these
+ * differ, so the counters shared between them are accessed atomically */
+static uint64_t progress_get(uint64_t const * x)
+{
+  uint64_t result;
+#ifdef HAVE_OPENMP
+  #pragma omp atomic read
+#endif
+  result = *x;
+  return result;
+}
+
+static void progress_set(uint64_t * x, uint64_t value)
+{
+#ifdef HAVE_OPENMP
+  #pragma omp atomic write
+#endif
+  *x = value;
+}
+
 static void report_file_info(file_t * f)
 {
   if (sox_globals.verbosity > 2)
@@ -449,11 +485,16 @@ static void progress_to_next_input_file(file_t * f, sox_effect_t * effp)
     user_skip = sox_false;
     fprintf(stderr, "\nSkipped (Ctrl-C twice to quit).\n");
   }
-  read_wide_samples = 0;
-  input_wide_samples = f->ft->signal.length / f->ft->signal.channels;
+  progress_set(&read_wide_samples, 0);
+  progress_set(&input_wide_samples, f->ft->signal.length / f->ft->signal.channels);
   if (show_progress && (sox_globals.verbosity < 3 ||
-                        (is_serial(combine_method) && input_count > 1)))
-    display_file_info(f->ft, f, sox_false);
+                        (is_serial(combine_method) && input_count > 1))) {
+    if (flowing) { /* Leave it to update_status, between status lines */
+      f->given_volume = f->volume;
+      progress_set(&info_due, current_input + 1);
+    }
+    else display_file_info(f->ft, f, sox_false);
+  }
   if (f->volume == HUGE_VAL)
     f->volume = 1;
   if (f->replay_gain != HUGE_VAL)
@@ -485,6 +526,39 @@ static void balance_input(sox_sample_t * buf, size_t ws, file_t * f)
   }
 }
 
+/* Adds n samples of x to p, saturating; returns the number of sums clipped.
+ * The same as SOX_ROUND_CLIP_COUNT(p[k] + (double)x[k]), but where SSE2 is
+ * available, four samples at a time. */
+static uint64_t mix_add(sox_sample_t * p, sox_sample_t const * x, size_t n)
+{
+  uint64_t clips = 0;
+  size_t k = 0;
+
+#ifdef __SSE2__
+  for (; k + 4 <= n; k += 4) {
+    __m128i a = _mm_loadu_si128((__m128i const *)(p + k));
+    __m128i b = _mm_loadu_si128((__m128i const *)(x + k));
+    __m128i sum = _mm_add_epi32(a, b);
+    /* Overflowed if a & b have the same sign, but the sum doesn't */
+    __m128i over = _mm_srai_epi32(_mm_andnot_si128(_mm_xor_si128(a, b),
+          _mm_xor_si128(a, sum)), 31);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(over));
+    if (mask) {
+      __m128i sat = _mm_xor_si128(_mm_srai_epi32(a, 31),
+          _mm_set1_epi32(SOX_SAMPLE_MAX));    /* MIN if a < 0, else MAX */
+      clips += (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3);
+      sum = _mm_or_si128(_mm_andnot_si128(over, sum), _mm_and_si128(over, sat));
+    }
+    _mm_storeu_si128((__m128i *)(p + k), sum);
+  }
+#endif
+  for (; k < n; ++k) {
+    double sample = p[k] + (double)x[k];
+    p[k] = SOX_ROUND_CLIP_COUNT(sample, clips);
+  }
+  return clips;
+}
+
 /* The input combiner: contains one sample buffer per input file, but only
  * needed if is_parallel(combine_method) */
 typedef struct {
@@ -508,7 +582,7 @@ static int combiner_start(sox_effect_t *effp)
       progress_to_next_input_file(files[i], effp);
       ws = max(ws, input_wide_samples);
     }
-    input_wide_samples = ws; /* Output length is that of longest input file. */
+    progress_set(&input_wide_samples, ws); /* Output length is that of longest input file. */
   }
   z->ilen = lsx_malloc(input_count * sizeof(*z->ilen));
   return SOX_SUCCESS;
@@ -543,41 +617,59 @@ static int combiner_drain(sox_effect_t *effp, sox_sample_t * obuf, size_t * osam
       break;
     } /* while */
   } /* is_serial */ else { /* else is_parallel() */
-    sox_sample_t * p = obuf;
-    for (i = 0; i < input_count; ++i) {
-      z->ilen[i] = sox_read_wide(files[i]->ft, z->ibuf[i], *osamp);
-      balance_input(z->ibuf[i], z->ilen[i], files[i]);
-      olen = max(olen, z->ilen[i]);
+    size_t channels = effp->in_signal.channels, offset = 0;
+    int n;
+
+    /* Decode the inputs concurrently: each reads from its own file into its
+     * own buffer (and counts its own volume clips) */
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for \
+        if(sox_globals.use_threads && input_count > 1) \
+        schedule(dynamic) default(none) shared(z, osamp, files, input_count)
+#endif
+    for (n = 0; n < (int)input_count; ++n) {
+      z->ilen[n] = sox_read_wide(files[n]->ft, z->ibuf[n], *osamp);
+      balance_input(z->ibuf[n], z->ilen[n], files[n]);
     }
-    for (ws = 0; ws < olen; ++ws) { /* wide samples */
+    for (i = 0; i < input_count; ++i)
+      olen = max(olen, z->ilen[i]);
+
+    /* Combine an input at a time, in input order, so that sums & products
+     * are formed (and clipped) in the same order as sample by sample */
+    if (combine_method == sox_mix || combine_method == sox_mix_power)
+      memset(obuf, 0, olen * channels * sizeof(*obuf));
+    for (i = 0; i < input_count; ++i) {
+      size_t ichannels = files[i]->ft->signal.channels;
+      size_t width = min(ichannels, channels), ilen = z->ilen[i];
+      sox_sample_t const * ibuf = z->ibuf[i];
+      sox_sample_t * p = obuf;
+
       if (combine_method == sox_mix || combine_method == sox_mix_power) {
-        for (s = 0; s < effp->in_signal.channels; ++s, ++p) { /* sum samples */
-          *p = 0;
-          for (i = 0; i < input_count; ++i)
-            if (ws < z->ilen[i] && s < files[i]->ft->signal.channels) {
-              /* Cast to double prevents integer overflow */
-              double sample = *p + (double)z->ibuf[i][ws * files[i]->ft->signal.channels + s];
+        if (ichannels == channels)
+          mixing_clips += mix_add(p, ibuf, ilen * channels);
+        else for (ws = 0; ws < ilen; ++ws, p += channels)
+          mixing_clips += mix_add(p, ibuf + ws * ichannels, width);
+      } /* sox_mix */ else if (combine_method == sox_multiply) {
+        for (ws = 0; ws < olen; ++ws)
+          for (s = 0; s < channels; ++s, ++p) {
+            sox_sample_t x = ws < ilen && s < ichannels?
+                ibuf[ws * ichannels + s] : 0;
+            if (i == 0)
+              *p = x;
+            else {
+              double sample = *p * (-1. / SOX_SAMPLE_MIN) * x;
               *p = SOX_ROUND_CLIP_COUNT(sample, mixing_clips);
             }
-        }
-      } /* sox_mix */ else if (combine_method == sox_multiply)  {
-        for (s = 0; s < effp->in_signal.channels; ++s, ++p) { /* multiply samples */
-          i = 0;
-          *p = ws < z->ilen[i] && s < files[i]->ft->signal.channels?
-            z->ibuf[i][ws * files[i]->ft->signal.channels + s] : 0;
-          for (++i; i < input_count; ++i) {
-            double sample = *p * (-1. / SOX_SAMPLE_MIN) * (ws < z->ilen[i] && s < files[i]->ft->signal.channels? z->ibuf[i][ws * files[i]->ft->signal.channels + s] : 0);
-            *p = SOX_ROUND_CLIP_COUNT(sample, mixing_clips);
           }
-        }
       } /* sox_multiply */ else { /* sox_merge: like a multi-track recorder */
-        for (i = 0; i < input_count; ++i)
-          for (s = 0; s < files[i]->ft->signal.channels; ++s)
-            *p++ = (ws < z->ilen[i]) * z->ibuf[i][ws * files[i]->ft->signal.channels + s];
+        for (ws = 0, p += offset; ws < olen; ++ws, p += channels)
+          for (s = 0; s < ichannels; ++s)
+            p[s] = ws < ilen? ibuf[ws * ichannels + s] : 0;
+        offset += ichannels;
       } /* sox_merge */
-    } /* wide samples */
+    }
   } /* is_parallel */
-  read_wide_samples += olen;
+  progress_set(&read_wide_samples, read_wide_samples + olen);
   olen *= effp->in_signal.channels;
   *osamp = olen;
 
@@ -1250,14 +1342,16 @@ static void display_status(sox_bool all_done)
   if (!show_progress)
     return;
   if (all_done || since(&then, .1, sox_false)) {
-    double read_time = (double)read_wide_samples / combiner_signal.rate;
+    uint64_t read = progress_get(&read_wide_samples);
+    uint64_t input = progress_get(&input_wide_samples);
+    double read_time = (double)read / combiner_signal.rate;
     double left_time = 0, in_time = 0, percentage = 0;
     char buf[128];
 
-    if (input_wide_samples) {
-      in_time = (double)input_wide_samples / combiner_signal.rate;
+    if (input) {
+      in_time = (double)input / combiner_signal.rate;
       left_time = max(in_time - read_time, 0);
-      percentage = max(100. * read_wide_samples / input_wide_samples, 0);
+      percentage = max(100. * read / input, 0);
     }
     snprintf(buf, min(termwidth + 2, sizeof(buf)),
       "\rIn:%-5s %s [%s] Out:%-5s [%6s|%-6s] %s Clip:%-5s",
@@ -1287,6 +1381,8 @@ static int kbhit(void)
 
 static int update_status(sox_bool all_done, void * client_data)
 {
+  uint64_t due;
+
   (void)client_data;
   if (interactive) while (kbhit()) {
     int LSX_UNUSED ch;
@@ -1335,35 +1431,98 @@ static int update_status(sox_bool all_done, void * client_data)
 #endif
   }
 
+  /* Show any input files reached since the last status line */
+  for (due = progress_get(&info_due); info_shown < due; ++info_shown) {
+    file_t f = *files[info_shown];
+    f.volume = f.given_volume;
+    display_file_info(f.ft, &f, sox_false);
+  }
   display_status(all_done || user_abort);
   return (user_abort || user_restart_eff) ? SOX_EOF : SOX_SUCCESS;
 }
 
 static void optimize_trim(void)
 {
-  /* Speed hack.  If the "trim" effect is the first effect then peek inside its
-   * "effect descriptor" and see what the start location is.  This has to be
-   * done after its start() is called to have the correct location.  Also, only
-   * do this when only working with one input file.  This is because the logic
-   * to do it for multiple files is complex and probably never used.  The same
-   * is true for a restarted or additional effects chain (relative positioning
-   * within the file and possible samples still buffered in the input effect
-   * would have to be taken into account).  This hack is a huge time savings
-   * when trimming gigs of audio data into managable chunks.  */
-  if (input_count == 1 && very_first_effchain && effects_chain->length > 1 &&
-      strcmp(effects_chain->effects[1][0].handler.name, "trim") == 0) {
-    if (files[0]->ft->handler.seek && files[0]->ft->seekable){
-      uint64_t offset = sox_trim_get_start(&effects_chain->effects[1][0]);
-      if (offset && sox_seek(files[0]->ft, offset, SOX_SEEK_SET) == SOX_SUCCESS) {
-        read_wide_samples = offset / files[0]->ft->signal.channels;
-        /* Assuming a failed seek stayed where it was.  If the seek worked then
-         * reset the start location of trim so that it thinks user didn't
-         * request a skip.  */
-        sox_trim_clear_start(&effects_chain->effects[1][0]);
-        lsx_debug("optimize_trim successful");
-      }
+  /* Speed hack.  If the "trim" effect is preceded only by effects that keep
+   * sample positions (vol, remix, etc.), and by at most one "rate", then peek
+   * inside its "effect descriptor" and see what the start location is, and
+   * seek the input(s) there (or, with rate, to a little before it, so that
+   * the resampling filters have settled, with trim discarding the rest; only
+   * if rate steps exactly, so the output is the same but for round-off).  This
+   * has to be done after trim's start() is called to have the correct
+   * location.  Only for one input file, or for several played in turn, where
+   * whole files before the start are skipped using their header lengths.
+   * Not done for a restarted or additional effects chain (relative
+   * positioning within the file and possible samples still buffered in the
+   * input effect would have to be taken into account).  Stateful effects
+   * (gain, filters, etc.) could not give the same output from a seek, so stop
+   * the search.  This hack is a huge time savings when trimming gigs of audio
+   * data into managable chunks.  */
+  static char const * const transparent[] =
+    {"channels", "dcshift", "remix", "speed", "vol", NULL};
+  sox_effect_t * trim = NULL, * rate = NULL;
+  uint64_t pos, seek_in, discard = 0, len;
+  size_t k, j, i = current_input;
+
+  if (!very_first_effchain || (input_count > 1 && !is_serial(combine_method)))
+    return;
+  for (k = 1; k < effects_chain->length && !trim; ++k) {
+    sox_effect_t * effp = &effects_chain->effects[k][0];
+    char const * name = effp->handler.name;
+
+    if (!strcmp(name, "trim"))
+      trim = effp;
+    else if (!strcmp(name, "rate") && !rate)
+      rate = effp;
+    else {
+      for (j = 0; transparent[j] && strcmp(name, transparent[j]); ++j);
+      if (!transparent[j])
+        return;
     }
   }
+  if (!trim || !(pos = sox_trim_get_start(trim) / trim->in_signal.channels))
+    return;
+  seek_in = pos;
+  if (rate) {
+    /* Output sample n * grid_out is at input sample n * grid_in, with rate's
+     * filters in the same phase, so seek to such a point, preroll before */
+    uint64_t grid_in, grid_out, cells, preroll;
+
+    if (!sox_rate_get_grid(rate, &grid_in, &grid_out, &preroll) ||
+        (double)grid_out * rate->in_signal.rate !=
+        (double)grid_in * rate->out_signal.rate)
+      return;
+    cells = pos / grid_out;
+    preroll = (preroll + grid_in - 1) / grid_in;
+    if (cells <= preroll)
+      return;
+    cells -= preroll;
+    seek_in = cells * grid_in;
+    discard = pos - cells * grid_out;
+  }
+  /* Skip any whole inputs */
+  while (i + 1 < input_count && can_segue(i + 1)) {
+    len = files[i]->ft->signal.length / files[i]->ft->signal.channels;
+    if (!len || files[i]->ft->signal.length == SOX_UNKNOWN_LEN ||
+        seek_in < len)
+      break;
+    seek_in -= len;
+    ++i;
+  }
+  if (seek_in && (!files[i]->ft->handler.seek || !files[i]->ft->seekable ||
+        sox_seek(files[i]->ft, seek_in * files[i]->ft->signal.channels,
+          SOX_SEEK_SET) != SOX_SUCCESS))
+    return;
+  /* Assuming a failed seek stayed where it was.  If the seek worked then
+   * reset the start location of trim to what is left to skip. */
+  if (i != current_input)
+    progress_to_next_input_file(files[current_input = i], NULL);
+  read_wide_samples = seek_in;
+  if (discard)
+    sox_trim_set_start(trim, discard * trim->in_signal.channels);
+  else sox_trim_clear_start(trim);
+  lsx_debug("optimize_trim successful: input #%lu at %" PRIu64 "%s",
+      (unsigned long)i + 1, seek_in, rate? " (with pre-roll)" : "");
 }
 
 static sox_bool overwrite_permitted(char const * filename)
@@ -1715,6 +1874,7 @@ static int process(void)
   if (!effects_chain)
     effects_chain = sox_create_effects_chain(&combiner_encoding,
                                              &ofile->ft->encoding);
+  effects_chain->float_samples = float_effects;
   add_effects(effects_chain);
 
   if (very_first_effchain)
@@ -1777,7 +1937,11 @@ static int process(void)
     d = now.tv_sec - load_timeofday.tv_sec + (now.tv_usec - load_timeofday.tv_usec) / TIME_FRAC;
     lsx_debug("start-up time = %g", d);
   }
+  sox_optimize_effects_chain(effects_chain);
+  info_shown = info_due = current_input + 1;
+  flowing = sox_true;
   flow_status = sox_flow_effects(effects_chain, update_status, NULL);
+  flowing = sox_false;
 
   /* Don't return SOX_EOF if
    * 1) input reach EOF and there are more input files to process or
@@ -1883,6 +2047,17 @@ static void display_supported_effects(void)
   puts("\n  * Deprecated effect    + Experimental effect    # LibSoX-only effect");
 }
 
+static void display_supported_ffts(void)
+{
+  size_t i;
+  char const * name;
+
+  printf("FFT IMPLEMENTATIONS:");
+  for (i = 0; (name = sox_fft_backend_name(i)); i++)
+    printf(" %s", name);
+  putchar('\n');
+}
+
 static void usage(char const * message)
 {
   const sox_version_info_t * info = sox_version_info();
@@ -1902,13 +2077,17 @@ static void usage(char const * message)
   static char const * const lines2[] = {
 "",
 "GLOBAL OPTIONS (gopts) (can be specified at any point before the first effect):",
+"--batch FILENAME         Run each line of FILENAME as a SoX command line",
 "--buffer BYTES           Set the size of all processing buffers (default 8192)",
 "--clobber                Don't prompt to overwrite output file (default)",
 "--combine concatenate    Concatenate all input files (default for sox, rec)",
 "--combine sequence       Sequence all input files (default for play)",
 "-D, --no-dither          Don't dither automatically",
 "--dft-min NUM            Minimum size (log2) for DFT processing (default 10)",
+"--dft-partition NUM      Partition size (log2) for long FIR filters (default 14)",
 "--effects-file FILENAME  File containing effects and options",
+"--fft NAME               Select the FFT implementation (see below)",
+"--float-effects          Pass floating-point audio between filter effects",
 "-G, --guard              Use temporary files to guard against clipping",
 "-h, --help               Display version number and usage information",
 "--help-effect NAME       Show usage of effect NAME, or NAME=all for all",
@@ -1916,6 +2095,7 @@ static void usage(char const * message)
 "--i, --info              Behave as soxi(1)",
 "--input-buffer BYTES     Override the input buffer size (default: as --buffer)",
 "--no-clobber             Prompt to overwrite output file",
+"--output-buffer BYTES    Set the output file write buffer size (default: 1M)",
 "-m, --combine mix        Mix multiple input files (instead of concatenating)",
 "--combine mix-power      Mix to equal power (instead of concatenating)",
 "-M, --combine merge      Merge multiple input files (instead of concatenating)"
@@ -1924,7 +2104,10 @@ static void usage(char const * message)
 "--magic                  Use `magic' file-type detection"
   };
   static char const * const linesThreads[] = {
-"--multi-threaded         Enable parallel effects channels processing"
+"--io-threads             Read input & write output on threads of their own",
+"--multi-threaded         Enable parallel effects channels processing",
+"--pipeline[=THREADS]     Run groups of effects in parallel (default: one",
+"                         thread per effect)"
   };
   static char const * const lines3[] = {
 "--norm                   Guard (see --guard) & normalise",
@@ -1935,6 +2118,7 @@ static void usage(char const * message)
 "-R                       Use default random numbers (same on each run of SoX)",
 "-S, --show-progress      Display progress while processing audio data",
 "--single-threaded        Disable parallel effects channels processing",
+"--spill-buffer BYTES     Audio to hold in memory for reverse etc. (default: 64M)",
 "--temp DIRECTORY         Specify the directory to use for temporary files",
 "-T, --combine multiply   Multiply samples of corresponding channels from all",
 "                         input files (instead of concatenating)",
@@ -1998,6 +2182,7 @@ static void usage(char const * message)
     puts(lines3[i]);
   display_supported_formats();
   display_supported_effects();
+  display_supported_ffts();
   printf("EFFECT OPTIONS (effopts): effect dependent; see --help-effect\n");
   exit(message != NULL);
 }
@@ -2172,6 +2357,14 @@ static struct lsx_option_t const long_options[] = {
   {"no-clobber"      , lsx_option_arg_none    , NULL, 0},
   {"multi-threaded"  , lsx_option_arg_none    , NULL, 0},
   {"dft-min"         , lsx_option_arg_required, NULL, 0},
+  {"pipeline"        , lsx_option_arg_optional, NULL, 0},
+  {"float-effects"   , lsx_option_arg_none    , NULL, 0},
+  {"fft"             , lsx_option_arg_required, NULL, 0},
+  {"dft-partition"   , lsx_option_arg_required, NULL, 0},
+  {"io-threads"      , lsx_option_arg_none    , NULL, 0},
+  {"output-buffer"   , lsx_option_arg_required, NULL, 0},
+  {"spill-buffer"    , lsx_option_arg_required, NULL, 0},
+  {"batch"           , lsx_option_arg_required, NULL, 0},
 
   {"bits"            , lsx_option_arg_required, NULL, 'b'},
   {"channels"        , lsx_option_arg_required, NULL, 'c'},
@@ -2364,6 +2557,58 @@ static char parse_gopts_and_fopts(file_t * f)
         }
         sox_globals.log2_dft_min_size = i;
         break;
+      case 26:
+        if (!(info->flags & sox_version_have_threads))
+          lsx_warn("this build of SoX does not include threads");
+        else if (!optstate.arg)
+          sox_globals.pipeline_stages = SOX_SIZE_MAX;
+        else if (sscanf(optstate.arg, "%i %c", &i, &dummy) != 1 || i < 1) {
+          lsx_fail("Pipeline threads `%s' must be a positive integer", optstate.arg);
+          exit(1);
+        }
+        else sox_globals.pipeline_stages = i;
+        break;
+      case 27: float_effects = sox_true; break;
+      case 28:
+        for (i = 0; sox_fft_backend_name(i) &&
+            strcmp(optstate.arg, sox_fft_backend_name(i)); ++i);
+        if (!sox_fft_backend_name(i)) {
+          lsx_fail("FFT implementation `%s' is not available", optstate.arg);
+          exit(1);
+        }
+        sox_globals.fft_backend = sox_fft_backend_name(i);
+        break;
+      case 29:
+        if (sscanf(optstate.arg, "%i %c", &i, &dummy) != 1 || i < 6 || i > 17) {
+          lsx_fail("DFT partition size must be in range 6 to 17");
+          exit(1);
+        }
+        sox_globals.log2_dft_partition_size = i;
+        break;
+      case 30:
+        if (!(info->flags & sox_version_have_threads))
+          lsx_warn("this build of SoX does not include threads");
+        else sox_globals.io_threads = sox_true;
+        break;
+      case 31:
+        if (sscanf(optstate.arg, "%i %c", &i, &dummy) != 1 || i <= SOX_BUFMIN) {
+          lsx_fail("Buffer size `%s' must be > %d", optstate.arg, SOX_BUFMIN);
+          exit(1);
+        }
+        sox_globals.output_bufsiz = i;
+        break;
+      case 32:
+        if (sscanf(optstate.arg, "%i %c", &i, &dummy) != 1 || i < 0) {
+          lsx_fail("Spill buffer size `%s' must not be negative", optstate.arg);
+          exit(1);
+        }
+        sox_globals.spill_bufsiz = i;
+        break;
+
+      case 33:
+        free(batch_filename);
+        batch_filename = lsx_strdup(optstate.arg);
+        break;
       }
       break;
 
@@ -2826,6 +3071,172 @@ static sox_bool cmp_comment_text(char const * c1, char const * c2)
   return c1 && c2 && !strcasecmp(c1, c2);
 }
 
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H)
+
+typedef struct {
+  pid_t          pid;           /* 0 if the slot is free */
+  size_t         line;          /* Line number in the batch file */
+  struct timeval start;
+} batch_job_t;
+
+static double seconds_since(struct timeval const * then)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec - then->tv_sec + (now.tv_usec - then->tv_usec) / TIME_FRAC;
+}
+
+/* Returns the next line of the given file (without its '\n'), or NULL at
+ * the end of the file. */
+static char * read_line(FILE * file)
+{
+  size_t size = 256, len = 0;
+  char * s = lsx_malloc(size);
+
+  while (fgets(s + len, (int)(size - len), file)) {
+    len += strlen(s + len);
+    if (len && s[len - 1] == '\n') {
+      s[len - 1] = '\0';
+      return s;
+    }
+    if (len == size - 1)
+      s = lsx_realloc(s, size <<= 1);
+    else break;   /* No '\n' at the end of the file (or a '\0' in it) */
+  }
+  if (len)
+    return s;
+  free(s);
+  return NULL;
+}
+
+/* Runs each (non-blank, non-comment) line of the batch file as the options,
+ * filenames & effects of a SoX command line, in a process forked from this
+ * one: so each job starts with the format handlers, etc. already loaded,
+ * and one that fails (where SoX exits) doesn't stop the others.  Up to one
+ * job per thread runs at a time (each job then being single-threaded).  In
+ * the parent, exits when all jobs are done; in a job's process, returns
+ * with argc & argv set to the job's command line, already parsed. */
+static void run_batch(int * argc, char * * * argv)
+{
+  FILE * file;
+  size_t workers = !sox_globals.use_threads? 1 : sox_globals.num_threads?
+      sox_globals.num_threads : (size_t)omp_get_max_threads();
+  batch_job_t * jobs;
+  char * * lines = NULL, * line;
+  size_t num_lines = 0, next = 0, running = 0, jobs_run = 0, failed = 0, i;
+  int exit_code = 0, status;
+  pid_t pid;
+  struct timeval start;
+
+  if (file_count || sox_mode != sox_sox)
+    usage("--batch cannot be given with filenames");
+  file = strcmp(batch_filename, "-")? fopen(batch_filename, "r") : stdin;
+  if (!file) {
+    lsx_fail("Cannot open batch file `%s': %s", batch_filename, strerror(errno));
+    exit(1);
+  }
+  /* Read the whole file now, so that no job's process shares the stream */
+  while ((line = read_line(file))) {
+    lsx_revalloc(lines, num_lines + 1);
+    lines[num_lines++] = line;
+  }
+  if (ferror(file)) {
+    lsx_fail("Error reading batch file `%s'", batch_filename);
+    exit(1);
+  }
+  if (file != stdin)
+    fclose(file);
+
+  sox_format_init(); /* Load any plugins once, for all jobs */
+  jobs = lsx_calloc(workers, sizeof(*jobs));
+  gettimeofday(&start, NULL);
+
+  while (sox_true) {
+    for (; next < num_lines && running < workers; ++next) {
+      char * s = lines[next];
+
+      for (; isspace((unsigned char)*s); ++s);
+      if (!*s || *s == '#')
+        continue;
+      for (i = 0; jobs[i].pid; ++i);
+      fflush(stdout), fflush(stderr);
+      if ((pid = fork()) < 0) {
+        lsx_fail("Cannot start the job at line %lu: %s",
+            (unsigned long)next + 1, strerror(errno));
+        exit(2);
+      }
+      if (!pid) {
+        /* Tokenise only the line: argv[0] (a path that may contain
+         * spaces or quotes) is kept as it is, in front */
+        int line_argc;
+        char * * line_argv = strtoargv(s, &line_argc);
+        char * * job_argv = lsx_malloc((line_argc + 2) * sizeof(*job_argv));
+
+        job_argv[0] = (*argv)[0];
+        for (i = 0; i < (size_t)line_argc; ++i)
+          job_argv[i + 1] = line_argv[i];
+        job_argv[line_argc + 1] = NULL;
+        free(line_argv);
+        *argc = line_argc + 1;
+        *argv = job_argv;
+        free(batch_filename);
+        batch_filename = NULL;
+        if (workers > 1) {
+          sox_globals.use_threads = sox_false;
+          show_progress = sox_option_no;
+        }
+        parse_options_and_filenames(*argc, *argv);
+        if (batch_filename)
+          usage("--batch cannot be given in a batch file");
+        return;
+      }
+      jobs[i].pid = pid;
+      jobs[i].line = next + 1;
+      gettimeofday(&jobs[i].start, NULL);
+      ++running, ++jobs_run;
+    }
+    if (!running)
+      break;
+    if ((pid = wait(&status)) < 0) {
+      lsx_fail("Cannot wait for jobs: %s", strerror(errno));
+      exit(2);
+    }
+    for (i = 0; i < workers && jobs[i].pid != pid; ++i);
+    if (i == workers)
+      continue;
+    if (WIFEXITED(status) && !WEXITSTATUS(status))
+      lsx_report("job at line %lu took %.3f s",
+          (unsigned long)jobs[i].line, seconds_since(&jobs[i].start));
+    else {
+      int code = WIFEXITED(status)? WEXITSTATUS(status) : 2;
+      lsx_warn("job at line %lu failed (exit status %d) after %.3f s",
+          (unsigned long)jobs[i].line, code, seconds_since(&jobs[i].start));
+      exit_code = max(exit_code, code);
+      ++failed;
+    }
+    jobs[i].pid = 0;
+    --running;
+  }
+  lsx_report("%lu jobs (%lu failed) took %.3f s", (unsigned long)jobs_run,
+      (unsigned long)failed, seconds_since(&start));
+  for (i = 0; i < num_lines; ++i)
+    free(lines[i]);
+  free(lines);
+  free(jobs);
+  exit(exit_code);
+}
+
+#else
+
+static void run_batch(int * argc, char * * * argv)
+{
+  (void)argc, (void)argv;
+  lsx_fail("--batch is not supported on this platform");
+  exit(1);
+}
+
+#endif
+
 int main(int argc, char **argv)
 {
   size_t i;
@@ -2863,6 +3274,9 @@ int main(int argc, char **argv)
 
   parse_options_and_filenames(argc, argv);
 
+  if (batch_filename)
+    run_batch(&argc, &argv); /* Returns only in the process for one job */
+
   if (sox_globals.verbosity > 2)
     display_SoX_version(stderr);
 
@@ -2956,6 +3370,14 @@ int main(int argc, char **argv)
    * memory although it would be more consistent to do so.
    */
 
+  /* Input read ahead by a pipelined chain would be lost to the next chain */
+  if (eff_chain_count > 1 &&
+      (sox_globals.pipeline_stages > 1 || sox_globals.io_threads)) {
+    lsx_report("not pipelining multiple effects chains");
+    sox_globals.pipeline_stages = 0;
+    sox_globals.io_threads = sox_false;
+  }
+
   /* Not the best way for users to do this; now deprecated in favour of soxi. */
   if (!show_progress && !nuser_effects[current_eff_chain] &&
       ofile->filetype && !strcmp(ofile->filetype, "null")) {
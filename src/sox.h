@@ -1067,6 +1067,9 @@ if clipping occurs.
 #define SOX_EFF_MODIFY   256         /**< Client API: Effect does not modify sample values (but might remove or duplicate samples or insert zeros) */
 #define SOX_EFF_ALPHA    512         /**< Client API: Effect is experimental/incomplete */
 #define SOX_EFF_INTERNAL 1024        /**< Client API: Effect present in libSoX but not valid for use by SoX command-line tools */
+#define SOX_EFF_PLANAR   2048        /**< Client API: Effect handles multiple channels internally and can work on uninterleaved buffers (see sox_effect_t.planar) */
+#define SOX_EFF_FLOAT    4096        /**< Client API: Effect can exchange samples with its neighbours as 32-bit floats (see sox_effect_t.in_float) */
+#define SOX_EFF_FUSE     8192        /**< Client API: Effect outputs one frame per input frame, with no delay and nothing to drain, so can be fused with like neighbours (see sox_optimize_effects_chain) */
 
 /**
 Client API:
@@ -1340,6 +1343,61 @@ typedef struct sox_globals_t {
   Plugins should use similarly-sized DFTs to get best performance.
   */
   size_t       log2_dft_min_size;
+
+  /**
+  Number of threads across which sox_flow_effects spreads the effects of a
+  chain, each running a group of adjacent effects (pipelining); 0 or 1 to
+  process the whole chain on the calling thread.
+  */
+  size_t       pipeline_stages;
+
+  /**
+  Maximum number of threads across which the channels of an effect are
+  processed when use_threads is set; 0 for the OpenMP default.
+  */
+  size_t       num_threads;
+
+  /**
+  Minimum number of samples for which processing the channels of an effect
+  is spread across threads; smaller blocks are processed on the calling
+  thread, where the cost of waking other threads would outweigh the gain.
+  */
+  size_t       threads_min_samples;
+
+  /**
+  Name of the FFT implementation used by the DFT-based effects, e.g. "sse2"
+  or "fft4g" (see sox_fft_backend_name); NULL, or an unknown name, selects
+  the default, which is the fastest available.
+  */
+  char const * fft_backend;
+
+  /**
+  Log to base 2 of the partition length (in taps) used by libSoX when
+  applying long FIR filters: filters with more taps are convolved in
+  partitions of this length, bounding their DFT size and latency.
+  */
+  size_t       log2_dft_partition_size;
+
+  /**
+  If true, sox_flow_effects runs the first and last effects of a chain
+  (normally those that read the input and write the output) on threads of
+  their own, joined to the rest of the chain by queues, so that file
+  decoding and encoding overlap with the processing of the other effects.
+  */
+  sox_bool     io_threads;
+
+  /**
+  Size (in bytes) of the write buffer given to stdio for output files (other
+  than stdout); 0 (the default) means 1 MiB, or bufsiz if that is larger.
+  */
+  size_t       output_bufsiz;
+
+  /**
+  Size (in bytes) of the audio that an effect such as reverse or gain -n
+  keeps in memory (for each channel it processes separately) before
+  spilling the rest to a temporary file.
+  */
+  size_t       spill_bufsiz;
 } sox_globals_t;
 
 /**
@@ -1536,6 +1594,9 @@ struct sox_format_t {
   sox_uint64_t     data_start;      /**< Offset at which headers end and sound data begins (set by lsx_check_read_params) */
   sox_format_handler_t handler;     /**< Format handler for this file */
   void             * priv;          /**< Format handler's private data area */
+  void             * map;           /**< Private: input file mapped into memory, or null */
+  sox_uint64_t     map_length;      /**< Private: length of the mapped input file */
+  char             * stdio_buf;     /**< Private: buffer given to setvbuf, or null */
 };
 
 /**
@@ -1595,6 +1656,9 @@ struct sox_effect_t {
   size_t                   obeg;      /**< output buffer: start of valid data section */
   size_t                   oend;      /**< output buffer: one past valid data section (oend-obeg is length of current content) */
   size_t               imin;          /**< minimum input buffer content required for calling this effect's flow function; set via lsx_effect_set_imin() */
+  sox_bool             planar;        /**< true if flow/drain are given uninterleaved buffers, one per channel, each sox_globals.bufsiz / channels samples apart; only for SOX_EFF_PLANAR effects */
+  sox_bool             in_float;      /**< true if the input buffer holds floats (full scale = 1) rather than sox_sample_t; only for SOX_EFF_FLOAT effects */
+  sox_bool             out_float;     /**< true if the output buffer is to be filled with floats; only for SOX_EFF_FLOAT effects */
 };
 
 /**
@@ -1610,6 +1674,8 @@ typedef struct sox_effects_chain_t {
   /* The following items are private to the libSoX effects chain functions. */
   size_t table_size;                       /**< Size of effects table (including unused entries) */
   sox_sample_t *il_buf;                    /**< Channel interleave buffer */
+  sox_bool planar;                         /**< Pass uninterleaved buffers to SOX_EFF_PLANAR effects (default: true) */
+  sox_bool float_samples;                  /**< Pass float samples between adjacent SOX_EFF_FLOAT effects (default: false) */
 } sox_effects_chain_t;
 
 /*****************************************************************************
@@ -2006,6 +2072,19 @@ Deprecated macro that returns global parameters for effects.
 */
 #define sox_effects_globals (*sox_get_effects_globals())
 
+/**
+Client API:
+Returns the name of one of the FFT implementations that may be selected
+via sox_globals.fft_backend; 0 gives the default.
+@returns Implementation name, or null if n is not less than the number of them.
+*/
+LSX_RETURN_OPT LSX_RETURN_PURE
+char const *
+LSX_API
+sox_fft_backend_name(
+    size_t n /**< Index of the implementation, from 0. */
+    );
+
 /**
 Client API:
 Finds the effect handler with the given name.
@@ -2096,6 +2175,23 @@ sox_add_effect(
     LSX_PARAM_IN    sox_signalinfo_t const * out /**< Output format. */
     );
 
+/**
+Client API:
+Optimizes an effects chain, added to but not yet run, for speed: each run
+of adjacent biquad filter effects (e.g. bass, treble, highpass) is merged
+into the first of them, which then applies the cascade in one pass; then
+each run of adjacent SOX_EFF_FUSE effects is replaced by a single effect
+that passes the audio through them a cache-sized block at a time.  The
+chain's effects are changed (those merged are deleted, and the chain's
+length reduced), so a client that inspects them, or adds further effects,
+should not call this.
+*/
+void
+LSX_API
+sox_optimize_effects_chain(
+    LSX_PARAM_INOUT sox_effects_chain_t * chain /**< Effects chain to optimize. */
+    );
+
 /**
 Client API:
 Runs the effects chain, returns SOX_SUCCESS if successful.
@@ -2184,6 +2280,25 @@ sox_delete_effects(
     LSX_PARAM_INOUT sox_effects_chain_t *chain /**< Effects chain from which to delete effects. */
     );
 
+/**
+Client API:
+Gets the positions (in wide samples) at which a started rate effect can be
+sought: each grid_in input samples give exactly grid_out output samples,
+with every filter stage back in the same phase, and a stream sought to such
+a position gives the same output (but for round-off) after preroll input
+samples.  Useful for seeking the input ahead of rate and trim.
+@returns false if the rate effect's stepping is inexact (with an irrational
+conversion ratio, or one approximated in fixed point), so cannot be sought.
+*/
+sox_bool
+LSX_API
+sox_rate_get_grid(
+    LSX_PARAM_IN sox_effect_t * effp, /**< Rate effect, started. */
+    LSX_PARAM_OUT sox_uint64_t * grid_in, /**< Input samples per grid cell. */
+    LSX_PARAM_OUT sox_uint64_t * grid_out, /**< Output samples per grid cell. */
+    LSX_PARAM_OUT sox_uint64_t * preroll /**< Input samples for the filters to settle. */
+    );
+
 /**
 Client API:
 Gets the sample offset of the start of the trim, useful for efficiently
@@ -2207,6 +2322,19 @@ sox_trim_clear_start(
     LSX_PARAM_INOUT sox_effect_t * effp /**< Trim effect. */
     );
 
+/**
+Client API:
+Sets the start of the trim to the given sample offset, for use when only
+part of the audio before the start has been skipped (e.g. when the client
+has sought to a little before it).
+*/
+void
+LSX_API
+sox_trim_set_start(
+    LSX_PARAM_INOUT sox_effect_t * effp, /**< Trim effect. */
+    sox_uint64_t start /**< Sample offset (not wide samples) still to be skipped; at most sox_trim_get_start(effp). */
+    );
+
 /**
 Client API:
 Returns true if the specified file is a known playlist file type.
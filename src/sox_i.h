@@ -56,6 +56,13 @@ assert_static(sizeof(off_t) == _FILE_OFFSET_BITS >> 3, OFF_T_BUILD_PROBLEM);
 
 FILE * lsx_tmpfile(void);
 
+typedef struct lsx_spill lsx_spill_t;
+lsx_spill_t * lsx_spill_create(void);
+int lsx_spill_write(lsx_spill_t * s, sox_sample_t const * buf, size_t n);
+sox_uint64_t lsx_spill_length(lsx_spill_t const * s);
+int lsx_spill_read(lsx_spill_t * s, sox_uint64_t pos, sox_sample_t * buf, size_t n);
+void lsx_spill_delete(lsx_spill_t * s);
+
 void lsx_debug_more_impl(char const * fmt, ...) LSX_PRINTF12;
 void lsx_debug_most_impl(char const * fmt, ...) LSX_PRINTF12;
 
@@ -121,6 +128,10 @@ void lsx_save_samples(sox_sample_t * const dest, double const * const src,
     size_t const n, sox_uint64_t * const clips);
 void lsx_load_samples(double * const dest, sox_sample_t const * const src,
     size_t const n);
+void lsx_effect_save_samples(sox_effect_t * effp, sox_sample_t * dest,
+    double const * src, size_t n);
+void lsx_effect_load_samples(sox_effect_t const * effp, double * dest,
+    sox_sample_t const * src, size_t n);
 
 #ifdef HAVE_BYTESWAP_H
 #include <byteswap.h>
@@ -140,6 +151,9 @@ void lsx_load_samples(double * const dest, sox_sample_t const * const src,
 
 /* Read and write basic data types from "ft" stream. */
 size_t lsx_readbuf(sox_format_t * ft, void *buf, size_t len);
+void lsx_map_input(sox_format_t * ft);
+void lsx_unmap_input(sox_format_t * ft);
+void const * lsx_read_mapped(sox_format_t * ft, size_t size, size_t * n);
 int lsx_skipbytes(sox_format_t * ft, size_t n);
 int lsx_padbytes(sox_format_t * ft, size_t n);
 size_t lsx_writebuf(sox_format_t * ft, void const *buf, size_t len);
@@ -297,6 +311,16 @@ char * lsx_usage_lines(char * * usage, char const * const * lines, size_t n);
 
 int lsx_effect_set_imin(sox_effect_t * effp, size_t imin);
 
+/* Distance between the channels of a buffer in planar (uninterleaved) form */
+#define lsx_plane_size(channels) (sox_globals.bufsiz / (channels))
+
+/* If effp & next are both biquad filter effects that have not yet flowed,
+ * appends next's filter to effp's as a cascaded section and returns true;
+ * next can then be removed from the chain.  float_link says how the
+ * sections are to pass samples between them (see sox_effect_t.in_float). */
+sox_bool lsx_biquad_absorb(sox_effect_t * effp, sox_effect_t const * next,
+    sox_bool float_link);
+
 int lsx_effects_init(void);
 int lsx_effects_quit(void);
 
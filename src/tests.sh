@@ -203,6 +203,38 @@ timeIO () {
   rm -f tmp.sox tmp.write tmp.read
 }
 
+# Effect tests: check name command...
+check () {
+  name=$1; shift
+  if "$@" 2>/dev/null; then
+    echo "ok     $name"
+  else
+    echo "*FAIL* $name"
+  fi
+}
+
+fails () {
+  ! "$@"
+}
+
+# Print the given `stats' level (of all channels) of a file: file stat
+level () {
+  ${bindir}/sox${EXEEXT} $1 -n stats 2>&1 | sed -n "s/^$2 lev dB *\([^ ]*\).*/\1/p"
+}
+
+# True if the peak level of file2 - file1 is below the given dB: file1 file2 dB
+same () {
+  l=`${bindir}/sox${EXEEXT} -m $1 -v -1 $2 -p | level - Pk`
+  test "$l" = -inf || awk "BEGIN {exit !($l < $3)}"
+}
+
+# True if the RMS level of a file is within .1dB (or the given tolerance)
+# of the given: file dB [tolerance-dB]
+rms_is () {
+  l=`level $1 RMS`; t=${3:-.1}
+  awk "BEGIN {exit !($l - ($2) < $t && ($2) - $l < $t)}"
+}
+
 # Don't try to test un-built formats
 skip_check () {
   while [ $# -ne 0 ]; do
@@ -261,6 +293,76 @@ rm output.u8
 
 echo "Checked $vectors vectors"
 
+# Effect tests, mostly on this (repeatable) stereo noise
+${bindir}/sox${EXEEXT} -R -r 8000 -n -b 32 -e float noise.wav synth 6 noise noise vol .5
+
+# gain -n -w: the same as the two-pass -n if the audio fits the window;
+# otherwise, never above the level
+${bindir}/sox${EXEEXT} noise.wav -b 32 output.wav fade 6 gain -n -w 7 -3
+${bindir}/sox${EXEEXT} noise.wav -b 32 unwindowed.wav fade 6 gain -n -3
+check "gain -n -w (fits)" cmp -s unwindowed.wav output.wav
+${bindir}/sox${EXEEXT} noise.wav -b 32 output.wav fade 6 gain -n -w .1 -3
+check "gain -n -w (look-ahead)" awk "BEGIN {exit !(`level output.wav Pk` <= -3)}"
+
+# trim's start is sought in the input, through rate, if that gives the same
+for r in 44100 16000 6000; do
+  ${bindir}/sox${EXEEXT} -V4 noise.wav -b 32 -e float output.wav rate $r trim 3 .5 2>&1 |
+    grep "optimize_trim successful" > /dev/null || echo "*FAIL* trim seek $r"
+  ${bindir}/sox${EXEEXT} noise.wav -t sox - |
+    ${bindir}/sox${EXEEXT} -t sox - -b 32 -e float unsought.wav rate $r trim 3 .5
+  check "trim seek through rate $r" same unsought.wav output.wav -120
+done
+
+# An impulse response, in dat format: rate channel-values...
+delta () {
+  ir_rate=$1; shift
+  (echo "; Sample Rate $ir_rate"; echo "; Channels $#"; echo 0 $*) > delta.dat
+}
+delta 8000 .5
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float output.wav convolve delta.dat vol 2
+check "convolve identity" same noise.wav output.wav -90
+delta 16000 .5
+${bindir}/sox${EXEEXT} -r 8000 -n output.wav synth 1 sine 0 vol 0 dcshift .5 convolve delta.dat trim .5 .25
+check "convolve resampled IR level" rms_is output.wav -12.04
+delta 8000 0 .5 .5 0
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float output.wav convolve delta.dat vol 2
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float swapped.wav remix 2 1
+check "convolve true stereo" same swapped.wav output.wav -90
+delta 8000 .5 .5 .5
+check "convolve channel mismatch" fails ${bindir}/sox${EXEEXT} noise.wav -n convolve delta.dat
+
+# --pipeline: the same output, however the chain is split across threads
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float unpiped.wav vol .5 rate 16000 reverb bass 3
+for p in pipeline pipeline=2 pipeline=3; do
+  rm -f output.wav
+  ${bindir}/sox${EXEEXT} --$p noise.wav -b 32 -e float output.wav vol .5 rate 16000 reverb bass 3
+  check "--$p" cmp -s unpiped.wav output.wav
+done
+
+# --batch: each line is a job; a job that fails doesn't stop the others
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float unbatched.wav vol .5 rate 16000
+cat > batch.txt << EOF
+# A comment, then a blank line
+
+noise.wav -b 32 -e float "output 1.wav" vol .5 rate 16000
+missing.wav -n
+noise.wav -b 32 -e float output2.wav vol .5 rate 16000
+EOF
+rm -f "output 1.wav" output2.wav
+check "--batch (failed job)" fails ${bindir}/sox${EXEEXT} --batch batch.txt
+check "--batch (quoted)" cmp -s unbatched.wav "output 1.wav"
+check "--batch" cmp -s unbatched.wav output2.wav
+
+# reverb -l: half the filters, but about the same level; with fewer filters
+# to average over, the level of the reverberation varies more, so allow .25dB
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float full.wav reverb -w
+${bindir}/sox${EXEEXT} noise.wav -b 32 -e float output.wav reverb -w -l
+check "reverb -l level" rms_is output.wav `level full.wav RMS` .25
+check "reverb -l differs" fails cmp -s full.wav output.wav
+
+rm -f noise.wav output.wav unwindowed.wav unsought.wav delta.dat swapped.wav \
+  unpiped.wav unbatched.wav batch.txt "output 1.wav" output2.wav full.wav
+
 channels=2
 samples=1e7
 timeIO s8 u8 s16 u16 s24 u24 s32 u32 f32 f64 au wav aiff aifc sph # FIXME?: caf flac dat
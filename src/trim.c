@@ -214,3 +214,13 @@ void sox_trim_clear_start(sox_effect_t *effp)
     priv_t *p = (priv_t*) effp->priv;
     p->samples_read = p->num_pos ? p->pos[0].sample : 0;
 }
+
+/* As sox_trim_clear_start, but for when the client has skipped only some
+ * of the samples before the start, leaving `start' (non-wide) samples
+ * still to be skipped by trim. */
+void sox_trim_set_start(sox_effect_t *effp, sox_uint64_t start)
+{
+    priv_t *p = (priv_t*) effp->priv;
+    sox_trim_clear_start(effp);
+    p->samples_read -= min(start / effp->in_signal.channels, p->samples_read);
+}
@@ -178,7 +178,7 @@ static int stop(sox_effect_t * effp)
 sox_effect_handler_t const * lsx_vol_effect_fn(void)
 {
   static sox_effect_handler_t handler = {
-    "vol", vol_usage, SOX_EFF_MCHAN | SOX_EFF_GAIN, getopts, start, flow, 0, stop, 0, sizeof(priv_t)
+    "vol", vol_usage, SOX_EFF_MCHAN | SOX_EFF_GAIN | SOX_EFF_FUSE, getopts, start, flow, 0, stop, 0, sizeof(priv_t)
   };
   return &handler;
 }